@@ -0,0 +1,355 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "analysis.h"
+#include "codec.h"
+
+
+namespace {
+
+using namespace Tracker;
+
+enum {
+  // bumped whenever the analysis changes so old caches are redone
+  CACHE_VERSION = 1,
+  // frames compared for the pitch estimate
+  PITCH_WINDOW = 2048,
+  // frames compared either side of a loop splice
+  SPLICE_WINDOW = 64,
+  // frames per level measurement when finding the sustain
+  LEVEL_BLOCK = 1024,
+  // rising zero crossings tried as the loop end
+  END_CANDIDATES = 16,
+};
+
+// range of fundamentals searched for
+const double MIN_PITCH_HZ = 30.0;
+const double MAX_PITCH_HZ = 2000.0;
+// yin threshold, lower dips in the difference function mean more periodic
+const double YIN_THRESHOLD = 0.15;
+// anything weaker than this fraction of the peak counts as silence
+const double SILENCE = 0.01;
+// loops are kept to the part of the sample at most this far below the loudest
+const double SUSTAIN = 0.25;
+// largest splice error relative to the signal energy for a usable loop
+const double MAX_SPLICE_ERROR = 0.1;
+
+double to_db(double v) {
+  return (v > 0.0) ? 20.0 * log10(v / 32768.0) : -INFINITY;
+}
+
+// mix any sample down to 16 bit mono
+void decode_mono(const sample_t &sample, std::vector<int16_t> &out) {
+  sample_decode(sample, out);
+  if (sample.channels == 2) {
+    for (uint32_t i = 0; i < sample.size; ++i) {
+      out[i] = int16_t((int32_t(out[i * 2]) + int32_t(out[i * 2 + 1])) / 2);
+    }
+    out.resize(sample.size);
+  }
+}
+
+// true if a rising zero crossing lies between frames i - 1 and i
+bool rising(const std::vector<int16_t> &x, uint32_t i) {
+  return i > 0 && x[i - 1] < 0 && x[i] >= 0;
+}
+
+// estimate the period in frames with the yin difference function over a
+// window of frames from offset, returning 0 if nothing periodic was found
+double find_period(const std::vector<int16_t> &x, uint32_t offset, uint32_t rate) {
+  const uint32_t min_lag = std::max<uint32_t>(2, uint32_t(rate / MAX_PITCH_HZ));
+  const uint32_t max_lag = uint32_t(rate / MIN_PITCH_HZ);
+  if (offset + PITCH_WINDOW + max_lag + 1 > x.size()) {
+    return 0.0;
+  }
+  const int16_t *s = x.data() + offset;
+  // cumulative mean normalised difference, d[0] is defined as 1
+  std::vector<double> d(max_lag + 2, 1.0);
+  double sum = 0.0;
+  for (uint32_t lag = 1; lag <= max_lag + 1; ++lag) {
+    int64_t diff = 0;
+    for (uint32_t j = 0; j < PITCH_WINDOW; ++j) {
+      const int32_t e = int32_t(s[j]) - int32_t(s[j + lag]);
+      diff += int64_t(e) * e;
+    }
+    sum += double(diff);
+    d[lag] = (sum > 0.0) ? double(diff) * lag / sum : 1.0;
+  }
+  // the first dip under the threshold is the fundamental, not a multiple
+  uint32_t best = 0;
+  for (uint32_t lag = min_lag; lag <= max_lag; ++lag) {
+    if (d[lag] < YIN_THRESHOLD) {
+      while (lag < max_lag && d[lag + 1] < d[lag]) {
+        ++lag;
+      }
+      best = lag;
+      break;
+    }
+  }
+  if (!best) {
+    return 0.0;
+  }
+  // refine between frames with a parabola through the dip
+  const double a = d[best - 1], b = d[best], c = d[best + 1];
+  const double denom = a - 2.0 * b + c;
+  const double shift = (denom > 0.0) ? 0.5 * (a - c) / denom : 0.0;
+  return double(best) + std::min(std::max(shift, -0.5), 0.5);
+}
+
+// sum of squared differences between the frames around two positions,
+// this is the click heard when a voice jumps from end back to start
+double splice_error(const std::vector<int16_t> &x, uint32_t start, uint32_t end) {
+  double err = 0.0;
+  for (uint32_t j = 0; j < SPLICE_WINDOW * 2; ++j) {
+    const int64_t a = int64_t(start) + j - SPLICE_WINDOW;
+    const int64_t b = int64_t(end) + j - SPLICE_WINDOW;
+    if (a < 0 || b >= int64_t(x.size())) {
+      continue;
+    }
+    const double e = double(x[size_t(a)]) - double(x[size_t(b)]);
+    err += e * e;
+  }
+  return err;
+}
+
+void find_loop(const std::vector<int16_t> &x, double period, uint32_t start, uint32_t end,
+               sample_analysis_t &out) {
+  // find the range of blocks that are close to the loudest
+  std::vector<double> level;
+  for (uint32_t i = start; i + LEVEL_BLOCK <= end; i += LEVEL_BLOCK) {
+    double sum = 0.0;
+    for (uint32_t j = 0; j < LEVEL_BLOCK; ++j) {
+      sum += double(x[i + j]) * double(x[i + j]);
+    }
+    level.push_back(sqrt(sum / LEVEL_BLOCK));
+  }
+  if (level.size() < 2) {
+    return;
+  }
+  const double loudest = *std::max_element(level.begin(), level.end());
+  size_t last = level.size() - 1;
+  while (last > 0 && level[last] < loudest * SUSTAIN) {
+    --last;
+  }
+  // loop the end of the sustain, leaving the attack in the first quarter
+  const uint32_t lo = start + std::max<uint32_t>((end - start) / 4, SPLICE_WINDOW);
+  const uint32_t hi = start + uint32_t(last + 1) * LEVEL_BLOCK - SPLICE_WINDOW;
+  if (hi <= lo) {
+    return;
+  }
+  // a whole number of periods covering half the sustain, at most a second
+  const uint32_t span = std::min<uint32_t>((hi - lo) / 2, uint32_t(period * 1000.0));
+  const uint32_t periods = std::max<uint32_t>(1, uint32_t(span / period));
+  const double length = periods * period;
+  if (length + lo >= hi) {
+    return;
+  }
+
+  // try the last few rising zero crossings of the sustain as the end, and
+  // for each every rising zero crossing within half a period of a whole
+  // number of periods before it as the start, keeping the closest match
+  double best = INFINITY;
+  uint32_t best_start = 0, best_end = 0;
+  uint32_t loop_end = hi;
+  for (uint32_t tries = 0; tries < END_CANDIDATES; ++tries) {
+    while (loop_end > lo && !rising(x, loop_end)) {
+      --loop_end;
+    }
+    if (double(loop_end) < double(lo) + length) {
+      break;
+    }
+    for (uint32_t n = periods; n >= std::max<uint32_t>(1, periods / 2); --n) {
+      const double ideal = double(loop_end) - n * period;
+      const uint32_t first = uint32_t(std::max(double(lo), ideal - period / 2));
+      const uint32_t final = uint32_t(std::min(double(loop_end - 1), ideal + period / 2));
+      for (uint32_t i = first; i <= final; ++i) {
+        if (!rising(x, i)) {
+          continue;
+        }
+        const double err = splice_error(x, i, loop_end);
+        if (err < best) {
+          best = err;
+          best_start = i;
+          best_end = loop_end;
+        }
+      }
+    }
+    --loop_end;
+  }
+  if (!best_end) {
+    return;
+  }
+  double energy = 0.0;
+  for (uint32_t j = 0; j < SPLICE_WINDOW * 2; ++j) {
+    const double v = x[best_end - SPLICE_WINDOW + j];
+    energy += v * v;
+  }
+  if (energy > 0.0 && best / energy <= MAX_SPLICE_ERROR) {
+    out.loopable = true;
+    out.loop_start = best_start;
+    out.loop_end = best_end;
+  }
+}
+
+}  // namespace
+
+namespace Tracker {
+
+void sample_analyse(const sample_t &sample, sample_analysis_t &out) {
+  out = sample_analysis_t();
+  out.end = sample.size;
+  if (sample.size == 0) {
+    return;
+  }
+  std::vector<int16_t> x;
+  decode_mono(sample, x);
+
+  // levels
+  int32_t peak = 0;
+  double sum = 0.0;
+  for (int16_t v : x) {
+    peak = std::max(peak, std::abs(int32_t(v)));
+    sum += double(v) * double(v);
+  }
+  out.peak_db = float(to_db(peak));
+  out.rms_db = float(to_db(sqrt(sum / double(x.size()))));
+  if (peak == 0) {
+    return;
+  }
+
+  // trim silence back to the nearest zero crossing so nothing clicks
+  const int32_t floor = int32_t(peak * SILENCE);
+  uint32_t start = 0;
+  while (start < sample.size && std::abs(int32_t(x[start])) <= floor) {
+    ++start;
+  }
+  uint32_t end = sample.size;
+  while (end > start && std::abs(int32_t(x[end - 1])) <= floor) {
+    --end;
+  }
+  while (start > 0 && (int32_t(x[start - 1]) * int32_t(x[start])) > 0) {
+    --start;
+  }
+  while (end < sample.size && (int32_t(x[end - 1]) * int32_t(x[end])) > 0) {
+    ++end;
+  }
+  out.start = start;
+  out.end = end;
+
+  // measure the pitch just past the attack
+  const uint32_t offset = start + std::min<uint32_t>((end - start) / 8, sample.sample_rate / 20);
+  const double period = find_period(x, offset, sample.sample_rate);
+  if (period <= 0.0) {
+    return;
+  }
+  const double note = 69.0 + 12.0 * log2(double(sample.sample_rate) / period / 440.0);
+  if (note < 0.0 || note > 127.0) {
+    return;
+  }
+  out.pitched = true;
+  out.root = uint32_t(std::lround(note));
+  // the player adds fine to the note so this cancels the error from root
+  out.fine = float(double(out.root) - note);
+
+  find_loop(x, period, start, end, out);
+}
+
+std::string analysis_path(const std::string &wave_path) {
+  return wave_path + ".analysis";
+}
+
+bool analysis_load(const std::string &wave_path, const wave_info_t &info,
+                   sample_analysis_t &out) {
+  FILE *fd = fopen(analysis_path(wave_path).c_str(), "r");
+  if (!fd) {
+    return false;
+  }
+  sample_analysis_t a;
+  bool version = false, wave = false;
+  bool ok = true;
+  char line[256];
+  while (ok && fgets(line, sizeof(line), fd)) {
+    if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+      continue;
+    }
+    char key[16] = { 0 };
+    int used = 0;
+    if (sscanf(line, "%15s%n", key, &used) != 1) {
+      ok = false;
+      break;
+    }
+    const char *args = line + used;
+    if (strcmp(key, "version") == 0) {
+      unsigned v = 0;
+      ok = version = sscanf(args, "%u", &v) == 1 && v == CACHE_VERSION;
+    }
+    else if (strcmp(key, "wave") == 0) {
+      unsigned frames = 0, channels = 0, rate = 0;
+      ok = wave = sscanf(args, "%u %u %u", &frames, &channels, &rate) == 3 &&
+        frames == info.samples && channels == info.channels && rate == info.rate;
+    }
+    else if (strcmp(key, "pitch") == 0) {
+      unsigned root = 0;
+      ok = a.pitched = sscanf(args, "%u %f", &root, &a.fine) == 2 && root <= 127;
+      a.root = root;
+    }
+    else if (strcmp(key, "trim") == 0) {
+      ok = sscanf(args, "%u %u", &a.start, &a.end) == 2 && a.end <= info.samples;
+    }
+    else if (strcmp(key, "loop") == 0) {
+      ok = a.loopable = sscanf(args, "%u %u", &a.loop_start, &a.loop_end) == 2 &&
+        a.loop_start < a.loop_end && a.loop_end <= info.samples;
+    }
+    else if (strcmp(key, "level") == 0) {
+      ok = sscanf(args, "%f %f", &a.peak_db, &a.rms_db) == 2;
+    }
+    else {
+      ok = false;
+    }
+  }
+  fclose(fd);
+  if (!ok || !version || !wave) {
+    return false;
+  }
+  out = a;
+  return true;
+}
+
+bool analysis_save(const std::string &wave_path, const wave_info_t &info,
+                   const sample_analysis_t &in) {
+  FILE *fd = fopen(analysis_path(wave_path).c_str(), "w");
+  if (!fd) {
+    return false;
+  }
+  fprintf(fd, "# sample analysis\n");
+  fprintf(fd, "version %u\n", unsigned(CACHE_VERSION));
+  fprintf(fd, "wave %u %u %u\n", info.samples, info.channels, info.rate);
+  if (in.pitched) {
+    fprintf(fd, "pitch %u %.9g\n", in.root, in.fine);
+  }
+  fprintf(fd, "trim %u %u\n", in.start, in.end);
+  if (in.loopable) {
+    fprintf(fd, "loop %u %u\n", in.loop_start, in.loop_end);
+  }
+  fprintf(fd, "level %.9g %.9g\n", in.peak_db, in.rms_db);
+  const bool ok = !ferror(fd);
+  return (fclose(fd) == 0) && ok;
+}
+
+void sample_analysis_get(const sample_t &sample, sample_analysis_t &out) {
+  const wave_info_t info = { sample.size, sample.channels, 0, sample.sample_rate };
+  if (!sample.path.empty() && analysis_load(sample.path, info, out)) {
+    return;
+  }
+  sample_analyse(sample, out);
+  if (!sample.path.empty()) {
+    // a read only library still works, it is just analysed every time
+    analysis_save(sample.path, info, out);
+  }
+}
+
+}  // namespace Tracker
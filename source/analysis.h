@@ -0,0 +1,64 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "tracker.h"
+#include "libwav.h"
+
+
+namespace Tracker {
+
+// properties of a sample used to set up an instrument without hand tuning
+struct sample_analysis_t {
+
+  sample_analysis_t()
+    : pitched(false)
+    , root(69)
+    , fine(0.f)
+    , start(0)
+    , end(0)
+    , loopable(false)
+    , loop_start(0)
+    , loop_end(0)
+    , peak_db(-INFINITY)
+    , rms_db(-INFINITY)
+  {
+  }
+
+  // true if a fundamental was found, root and fine are only set if so
+  bool pitched;
+  // instrument root and fine tune that play the sample at its own pitch
+  uint32_t root;
+  float fine;
+  // the sample with leading and trailing silence trimmed at zero crossings
+  uint32_t start;
+  uint32_t end;
+  // a whole number of periods in the sustain with matching zero crossings
+  bool loopable;
+  uint32_t loop_start;
+  uint32_t loop_end;
+  // levels relative to full scale
+  float peak_db;
+  float rms_db;
+};
+
+// analyse a sample, this reads the whole sample so run it off the ui thread
+void sample_analyse(const sample_t &sample, sample_analysis_t &out);
+
+// results are cached in a text file next to the wave file, keyed by the
+// rate, channels and length of the wave so a stale cache is ignored
+std::string analysis_path(const std::string &wave_path);
+
+// read the cache for a wave file, returning false if it is missing or stale
+bool analysis_load(const std::string &wave_path, const wave_info_t &info,
+                   sample_analysis_t &out);
+
+bool analysis_save(const std::string &wave_path, const wave_info_t &info,
+                   const sample_analysis_t &in);
+
+// return the cached analysis of a sample loaded from a wave file, analysing
+// it and writing the cache if there is none
+void sample_analysis_get(const sample_t &sample, sample_analysis_t &out);
+
+}  // namespace Tracker
@@ -0,0 +1,133 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#include "bank.h"
+#include "codec.h"
+#include "sample_pool.h"
+#include "dsp.h"
+#include "trace.h"
+
+
+namespace {
+
+bool is_absolute(const std::string &path) {
+  if (path.empty()) {
+    return false;
+  }
+  if (path[0] == '/' || path[0] == '\\') {
+    return true;
+  }
+  // drive letter
+  return path.size() > 1 && path[1] == ':';
+}
+
+}  // namespace
+
+namespace Tracker {
+
+std::string path_resolve(const std::string &base, const std::string &path) {
+  if (is_absolute(path)) {
+    return path;
+  }
+  const size_t i = base.find_last_of("/\\");
+  return (i == std::string::npos) ? path : base.substr(0, i + 1) + path;
+}
+
+std::shared_ptr<sample_t> sample_load(const char *path) {
+  wave_t wave;
+  if (!wave.load(path)) {
+    return nullptr;
+  }
+  auto sample = sample_from_wave(wave);
+  sample->path = path;
+  return sample;
+}
+
+std::shared_ptr<sample_t> sample_from_wave(const wave_t &wave) {
+  TRACE_ZONE("sample_from_wave");
+  const uint32_t frames = wave.num_frames();
+  const uint32_t channels = std::min<uint32_t>(wave.num_channels(), 2);
+  auto sample = std::make_shared<sample_t>();
+  sample->sample_rate = wave.sample_rate();
+  sample->channels = channels;
+  // keep 8 bit waves at 8 bits, anything else is converted to 16 bits
+  sample->format = (wave.bit_depth() == 8) ? SAMPLE_S8 : SAMPLE_S16;
+  sample->alloc(frames);
+  if (sample->format == SAMPLE_S8) {
+    // wave files store 8 bit samples unsigned
+    const uint32_t count = std::min(frames * channels, wave.length());
+    dsp().u8_to_s8(wave.get<uint8_t>(), sample->get<int8_t>(), count);
+  }
+  else {
+    int16_t *dst = sample->get<int16_t>();
+    for (uint32_t i = 0; i < frames; ++i) {
+      for (uint32_t c = 0; c < channels; ++c) {
+        dst[i * channels + c] = int16_t(wave.get_sample(i, c));
+      }
+    }
+  }
+  sample->peaks.build(*sample);
+  return sample;
+}
+
+bool bank_t::load(const char *path, sample_pool_t *pool) {
+  entries.clear();
+  FILE *fd = fopen(path, "r");
+  if (!fd) {
+    return false;
+  }
+  bool ok = true;
+  char line[1024];
+  while (ok && fgets(line, sizeof(line), fd)) {
+    unsigned instrument = 0, root = 69;
+    char name[1024] = { 0 };
+    char format_name[16] = { 0 };
+    if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+      continue;
+    }
+    if (sscanf(line, "%u %1023s %u %15s", &instrument, name, &root, format_name) < 2) {
+      ok = false;
+      break;
+    }
+    if (instrument >= MAX_INSTUMENTS || root > 127) {
+      ok = false;
+      break;
+    }
+    const std::string wav_path = path_resolve(path, name);
+    std::shared_ptr<const sample_t> sample =
+      pool ? pool->get(wav_path) : sample_load(wav_path.c_str());
+    if (!sample) {
+      ok = false;
+      break;
+    }
+    if (format_name[0]) {
+      sample_format_t format;
+      if (!sample_format_parse(format_name, format)) {
+        ok = false;
+        break;
+      }
+      if (format != sample->format) {
+        sample = sample_encode(*sample, format);
+      }
+    }
+    entries.push_back(entry_t{ uint8_t(instrument), uint8_t(root), std::move(sample) });
+  }
+  fclose(fd);
+  return ok;
+}
+
+void bank_t::apply(song_t &song) const {
+  for (const auto &e : entries) {
+    auto &ins = song.instruments[e.instrument];
+    ins.root = e.root;
+    ins.sample_start = 0;
+    ins.sample_end = e.sample->size;
+    // the song is not playing yet so the old sample can go right away
+    ins.set_sample(e.sample);
+  }
+}
+
+}  // namespace Tracker
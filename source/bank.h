@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tracker.h"
+#include "libwav.h"
+
+
+namespace Tracker {
+
+struct sample_pool_t;
+
+// convert a wave into a sample ready for playback
+std::shared_ptr<sample_t> sample_from_wave(const wave_t &wave);
+
+// load a wav file into a sample, returning nullptr on failure
+std::shared_ptr<sample_t> sample_load(const char *path);
+
+// resolve path relative to the directory containing the file base
+// absolute paths are returned unchanged
+std::string path_resolve(const std::string &base, const std::string &path);
+
+// a set of samples to be assigned to instruments
+//
+// loaded from a text file with one instrument per line in the form:
+//   <instrument> <wav path> [root] [format]
+// blank lines and lines starting with '#' are ignored. relative wav paths
+// are resolved relative to the bank file. format is one of the names from
+// sample_format_name() and the sample is stored that way in memory.
+struct bank_t {
+
+  struct entry_t {
+    uint8_t instrument;
+    uint8_t root;
+    std::shared_ptr<const sample_t> sample;
+  };
+
+  // samples are taken from the pool when one is given so that banks
+  // sharing wav files also share the sample data
+  bool load(const char *path, sample_pool_t *pool = nullptr);
+
+  // assign the bank samples to the instruments of a song
+  // samples are immutable so one bank may be shared between many songs
+  void apply(song_t &song) const;
+
+  std::vector<entry_t> entries;
+};
+
+}  // namespace Tracker
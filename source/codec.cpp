@@ -0,0 +1,260 @@
+#include <cstring>
+#include <algorithm>
+
+#include "codec.h"
+#include "trace.h"
+
+
+namespace {
+
+using namespace Tracker;
+
+constexpr int32_t ULAW_BIAS = 0x84;
+constexpr int32_t ULAW_CLIP = 32635;
+
+// g.711 mu-law expansion
+constexpr int16_t ulaw_expand(uint8_t v) {
+  v = uint8_t(~v);
+  const int32_t exponent = (v >> 4) & 7;
+  const int32_t mantissa = v & 15;
+  const int32_t magnitude = (((mantissa << 3) + ULAW_BIAS) << exponent) - ULAW_BIAS;
+  return int16_t((v & 0x80) ? -magnitude : magnitude);
+}
+
+const int16_t adpcm_steps[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+  11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767,
+};
+
+const int8_t adpcm_index[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+// ima adpcm decoder state for one channel
+struct adpcm_state_t {
+
+  adpcm_state_t(int32_t predictor, int32_t index)
+    : predictor(predictor)
+    , index(std::min(std::max(index, 0), 88))
+  {
+  }
+
+  // apply one nibble returning the new predictor
+  int32_t decode(uint32_t nibble) {
+    const int32_t step = adpcm_steps[index];
+    int32_t diff = step >> 3;
+    if (nibble & 1) diff += step >> 2;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 4) diff += step;
+    predictor += (nibble & 8) ? -diff : diff;
+    predictor = std::min(std::max(predictor, -32768), 32767);
+    index = std::min(std::max(index + adpcm_index[nibble], 0), 88);
+    return predictor;
+  }
+
+  // choose the nibble that best moves the predictor towards v
+  uint32_t encode(int32_t v) {
+    int32_t diff = v - predictor;
+    uint32_t nibble = 0;
+    if (diff < 0) {
+      nibble = 8;
+      diff = -diff;
+    }
+    int32_t step = adpcm_steps[index];
+    for (uint32_t bit = 4; bit; bit >>= 1) {
+      if (diff >= step) {
+        nibble |= bit;
+        diff -= step;
+      }
+      step >>= 1;
+    }
+    // track the decoder so that errors do not accumulate
+    decode(nibble);
+    return nibble;
+  }
+
+  int32_t predictor;
+  int32_t index;
+};
+
+void adpcm_encode(const std::vector<int16_t> &src, sample_t &dst) {
+  const uint32_t channels = dst.channels;
+  const uint32_t blocks = uint32_t(dst.bytes() / dst.adpcm_block_bytes());
+  const uint32_t channel_bytes = ADPCM_HEADER_BYTES + ADPCM_BLOCK_FRAMES / 2;
+  memset(dst.data.get(), 0, dst.bytes());
+  for (uint32_t c = 0; c < channels; ++c) {
+    int32_t index = 0;
+    for (uint32_t b = 0; b < blocks; ++b) {
+      const uint32_t first = b * ADPCM_BLOCK_FRAMES;
+      const uint32_t count = std::min<uint32_t>(ADPCM_BLOCK_FRAMES, dst.size - first);
+      // start each block exactly on its first frame and carry the step
+      // index over so the encoder does not have to adapt again
+      adpcm_state_t state{ src[first * channels + c], index };
+      uint8_t *out = dst.data.get() + size_t(b) * dst.adpcm_block_bytes() + c * channel_bytes;
+      out[0] = uint8_t(state.predictor & 0xff);
+      out[1] = uint8_t((state.predictor >> 8) & 0xff);
+      out[2] = uint8_t(state.index);
+      uint8_t *nibbles = out + ADPCM_HEADER_BYTES;
+      for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t n = state.encode(src[(first + i) * channels + c]);
+        nibbles[i >> 1] |= uint8_t(n << ((i & 1) * 4));
+      }
+      index = state.index;
+    }
+  }
+}
+
+}  // namespace
+
+namespace Tracker {
+
+#define U4(x) ulaw_expand(x), ulaw_expand(x + 1), ulaw_expand(x + 2), ulaw_expand(x + 3)
+#define U16(x) U4(x), U4(x + 4), U4(x + 8), U4(x + 12)
+#define U64(x) U16(x), U16(x + 16), U16(x + 32), U16(x + 48)
+
+constexpr int16_t ulaw_table[256] = { U64(0), U64(64), U64(128), U64(192) };
+
+#undef U64
+#undef U16
+#undef U4
+
+uint8_t ulaw_encode(int16_t v) {
+  int32_t x = v;
+  const uint8_t sign = (x < 0) ? 0x80 : 0;
+  if (x < 0) {
+    x = -x;
+  }
+  x = std::min(x, ULAW_CLIP) + ULAW_BIAS;
+  int32_t exponent = 7;
+  for (int32_t mask = 0x4000; exponent > 0 && !(x & mask); mask >>= 1) {
+    --exponent;
+  }
+  const int32_t mantissa = (x >> (exponent + 3)) & 15;
+  return uint8_t(~(sign | (exponent << 4) | mantissa));
+}
+
+void adpcm_decode(const sample_t &sample, uint32_t block, uint32_t channel,
+                  int16_t *out, uint32_t count) {
+  const uint8_t *in = sample.data.get() + size_t(block) * sample.adpcm_block_bytes() +
+                      channel * (ADPCM_HEADER_BYTES + ADPCM_BLOCK_FRAMES / 2);
+  adpcm_state_t state{ int16_t(in[0] | (in[1] << 8)), in[2] };
+  const uint8_t *nibbles = in + ADPCM_HEADER_BYTES;
+  for (uint32_t i = 0; i < count; ++i) {
+    out[i] = int16_t(state.decode((nibbles[i >> 1] >> ((i & 1) * 4)) & 15));
+  }
+}
+
+void sample_decode(const sample_t &sample, std::vector<int16_t> &out) {
+  const uint32_t channels = sample.channels;
+  const size_t count = size_t(sample.size) * channels;
+  out.resize(count);
+  switch (sample.format) {
+  case SAMPLE_S8:
+    for (size_t i = 0; i < count; ++i) {
+      out[i] = int16_t(sample.get<int8_t>()[i] * 256);
+    }
+    break;
+  case SAMPLE_S16:
+    std::copy(sample.get<int16_t>(), sample.get<int16_t>() + count, out.begin());
+    break;
+  case SAMPLE_ULAW:
+    for (size_t i = 0; i < count; ++i) {
+      out[i] = ulaw_decode(sample.get<uint8_t>()[i]);
+    }
+    break;
+  case SAMPLE_ADPCM: {
+    int16_t temp[ADPCM_BLOCK_FRAMES];
+    for (uint32_t first = 0; first < sample.size; first += ADPCM_BLOCK_FRAMES) {
+      const uint32_t frames = std::min<uint32_t>(ADPCM_BLOCK_FRAMES, sample.size - first);
+      for (uint32_t c = 0; c < channels; ++c) {
+        adpcm_decode(sample, first / ADPCM_BLOCK_FRAMES, c, temp, frames);
+        for (uint32_t i = 0; i < frames; ++i) {
+          out[size_t(first + i) * channels + c] = temp[i];
+        }
+      }
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+std::shared_ptr<sample_t> sample_encode(const sample_t &sample, sample_format_t format) {
+  TRACE_ZONE("sample_encode");
+  std::vector<int16_t> pcm;
+  sample_decode(sample, pcm);
+  auto out = std::make_shared<sample_t>();
+  out->sample_rate = sample.sample_rate;
+  out->channels = sample.channels;
+  out->format = format;
+  out->alloc(sample.size);
+  switch (format) {
+  case SAMPLE_S8:
+    for (size_t i = 0; i < pcm.size(); ++i) {
+      out->get<int8_t>()[i] = int8_t(pcm[i] >> 8);
+    }
+    break;
+  case SAMPLE_S16:
+    std::copy(pcm.begin(), pcm.end(), out->get<int16_t>());
+    break;
+  case SAMPLE_ULAW:
+    for (size_t i = 0; i < pcm.size(); ++i) {
+      out->get<uint8_t>()[i] = ulaw_encode(pcm[i]);
+    }
+    break;
+  case SAMPLE_ADPCM:
+    adpcm_encode(pcm, *out);
+    break;
+  default:
+    break;
+  }
+  out->peaks = sample.peaks;
+  out->path = sample.path;
+  return out;
+}
+
+const char *sample_format_name(sample_format_t format) {
+  static const char *names[NUM_SAMPLE_FORMATS] = { "s8", "s16", "ulaw", "adpcm" };
+  return (format < NUM_SAMPLE_FORMATS) ? names[format] : "unknown";
+}
+
+bool sample_format_parse(const char *name, sample_format_t &format) {
+  for (uint32_t i = 0; i < NUM_SAMPLE_FORMATS; ++i) {
+    if (strcmp(name, sample_format_name(sample_format_t(i))) == 0) {
+      format = sample_format_t(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+int16_t sample_t::frame(uint32_t i) const {
+  int32_t sum = 0;
+  if (format == SAMPLE_ADPCM) {
+    int16_t temp[ADPCM_BLOCK_FRAMES];
+    const uint32_t offset = i % ADPCM_BLOCK_FRAMES;
+    for (uint32_t c = 0; c < channels; ++c) {
+      adpcm_decode(*this, i / ADPCM_BLOCK_FRAMES, c, temp, offset + 1);
+      sum += temp[offset];
+    }
+    return int16_t(sum / int32_t(channels));
+  }
+  for (uint32_t c = 0; c < channels; ++c) {
+    const uint32_t j = i * channels + c;
+    switch (format) {
+    case SAMPLE_S8:   sum += int32_t(get<int8_t>()[j]) << 8; break;
+    case SAMPLE_ULAW: sum += ulaw_decode(get<uint8_t>()[j]); break;
+    default:          sum += get<int16_t>()[j]; break;
+    }
+  }
+  return int16_t(sum / int32_t(channels));
+}
+
+}  // namespace Tracker
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "tracker.h"
+
+
+namespace Tracker {
+
+// 16 bit value of each mu-law byte
+extern const int16_t ulaw_table[256];
+
+inline int16_t ulaw_decode(uint8_t v) {
+  return ulaw_table[v];
+}
+
+uint8_t ulaw_encode(int16_t v);
+
+// adpcm blocks store each channel as a header followed by the nibbles of
+// ADPCM_BLOCK_FRAMES frames, lowest nibble first. the header holds the
+// predictor and step index before the first frame so any block can be
+// decoded without the ones before it.
+
+// decode the first count frames of one channel of an adpcm block
+void adpcm_decode(const sample_t &sample, uint32_t block, uint32_t channel,
+                  int16_t *out, uint32_t count);
+
+// decode any sample into interleaved 16 bit frames
+void sample_decode(const sample_t &sample, std::vector<int16_t> &out);
+
+// store a sample in another format
+// the peaks and path are kept from the source so nothing is rebuilt
+std::shared_ptr<sample_t> sample_encode(const sample_t &sample, sample_format_t format);
+
+const char *sample_format_name(sample_format_t format);
+
+// return false if the name is not a known format
+bool sample_format_parse(const char *name, sample_format_t &format);
+
+}  // namespace Tracker
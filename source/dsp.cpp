@@ -0,0 +1,190 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "dsp.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define DSP_X86 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define DSP_X86 1
+#endif
+
+
+namespace {
+
+using namespace Tracker;
+
+void mono_to_stereo_scalar(const int16_t *in, int16_t *out, uint32_t samples) {
+  for (uint32_t i = 0; i < samples; ++i) {
+    out[i * 2 + 0] = in[i];
+    out[i * 2 + 1] = in[i];
+  }
+}
+
+void u8_to_s8_scalar(const uint8_t *in, int8_t *out, uint32_t samples) {
+  for (uint32_t i = 0; i < samples; ++i) {
+    out[i] = int8_t(in[i] ^ 0x80);
+  }
+}
+
+phase_t resample_nearest_scalar(const int16_t *data, phase_t phase, phase_t step,
+                                int16_t *out, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    const int32_t v = data[phase >> PHASE_BITS];
+    out[i] += (v * 12) >> 8;
+    phase += step;
+  }
+  return phase;
+}
+
+phase_t resample_linear_scalar(const int16_t *data, phase_t phase, phase_t step,
+                               int16_t *out, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t index = uint32_t(phase >> PHASE_BITS);
+    const int32_t a = data[index];
+    const int32_t b = data[index + 1];
+    const int32_t frac = int32_t(uint32_t(phase) >> 17);
+    const int32_t v = a + (((b - a) * frac) >> 15);
+    out[i] += (v * 12) >> 8;
+    phase += step;
+  }
+  return phase;
+}
+
+int32_t dot_s16_scalar(const int16_t *a, const int16_t *b, uint32_t count) {
+  int32_t sum = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    sum += int32_t(a[i]) * int32_t(b[i]);
+  }
+  return sum;
+}
+
+#if defined(DSP_X86)
+void cpuid(uint32_t leaf, uint32_t sub, uint32_t reg[4]) {
+#if defined(_MSC_VER)
+  __cpuidex(reinterpret_cast<int *>(reg), int(leaf), int(sub));
+#else
+  __cpuid_count(leaf, sub, reg[0], reg[1], reg[2], reg[3]);
+#endif
+}
+
+// the extended register state the os has enabled
+uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  uint32_t lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (uint64_t(hi) << 32) | lo;
+#endif
+}
+#endif
+
+dsp_level_t detect_cpu() {
+#if defined(DSP_X86)
+  uint32_t r[4];
+  cpuid(0, 0, r);
+  const uint32_t max_leaf = r[0];
+  cpuid(1, 0, r);
+  dsp_level_t level = (r[3] & (1u << 26)) ? DSP_SSE2 : DSP_SCALAR;
+  // avx needs the os to save the ymm/zmm registers
+  const bool osxsave = (r[2] & (1u << 27)) != 0;
+  if (!osxsave || max_leaf < 7) {
+    return level;
+  }
+  const uint64_t xcr0 = xgetbv0();
+  cpuid(7, 0, r);
+  if ((xcr0 & 0x6) == 0x6 && (r[1] & (1u << 5))) {
+    level = DSP_AVX2;
+    // avx512f and avx512bw plus opmask and zmm state
+    if ((xcr0 & 0xe6) == 0xe6 && (r[1] & (1u << 16)) && (r[1] & (1u << 30))) {
+      level = DSP_AVX512;
+    }
+  }
+  return level;
+#else
+  return DSP_SCALAR;
+#endif
+}
+
+dsp_level_t forced_level(dsp_level_t best) {
+  const char *env = getenv("TRACKER_SIMD");
+  if (!env) {
+    return best;
+  }
+  for (int i = 0; i < NUM_DSP_LEVELS; ++i) {
+    if (strcmp(env, dsp_level_name(dsp_level_t(i))) == 0) {
+      // never go above what the cpu can do
+      return (dsp_level_t(i) < best) ? dsp_level_t(i) : best;
+    }
+  }
+  return best;
+}
+
+}  // namespace
+
+namespace Tracker {
+
+const char *dsp_level_name(dsp_level_t level) {
+  switch (level) {
+  case DSP_SCALAR: return "scalar";
+  case DSP_SSE2:   return "sse2";
+  case DSP_AVX2:   return "avx2";
+  case DSP_AVX512: return "avx512";
+  default:         return "unknown";
+  }
+}
+
+dsp_level_t dsp_detect() {
+  dsp_level_t level = detect_cpu();
+  // drop down to the best level that was actually compiled in
+  while (level != DSP_SCALAR) {
+    dsp_t ops;
+    if (dsp_bind(level, ops)) {
+      break;
+    }
+    level = dsp_level_t(level - 1);
+  }
+  return level;
+}
+
+bool dsp_bind(dsp_level_t level, dsp_t &out) {
+  if (level > detect_cpu()) {
+    return false;
+  }
+  out.level = level;
+  out.mono_to_stereo = mono_to_stereo_scalar;
+  out.u8_to_s8 = u8_to_s8_scalar;
+  out.resample_nearest = resample_nearest_scalar;
+  out.resample_linear = resample_linear_scalar;
+  out.dot_s16 = dot_s16_scalar;
+  // each level builds on the kernels of the one below it
+  switch (level) {
+  case DSP_SCALAR:
+    return true;
+  case DSP_SSE2:
+    return dsp_bind_sse2(out);
+  case DSP_AVX2:
+    return dsp_bind_sse2(out) && dsp_bind_avx2(out);
+  case DSP_AVX512:
+    return dsp_bind_sse2(out) && dsp_bind_avx2(out) && dsp_bind_avx512(out);
+  default:
+    return false;
+  }
+}
+
+const dsp_t &dsp() {
+  // bound once in a thread safe way on first use
+  static const dsp_t ops = []() {
+    dsp_t ops;
+    if (!dsp_bind(forced_level(dsp_detect()), ops)) {
+      dsp_bind(DSP_SCALAR, ops);
+    }
+    return ops;
+  }();
+  return ops;
+}
+
+}  // namespace Tracker
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+
+#include "tracker.h"
+
+
+namespace Tracker {
+
+// instruction set levels a dsp kernel table can be bound to
+enum dsp_level_t {
+  DSP_SCALAR,
+  DSP_SSE2,
+  DSP_AVX2,
+  DSP_AVX512,
+  NUM_DSP_LEVELS,
+};
+
+// a table of dsp kernels bound to one instruction set level
+// every level produces output identical to DSP_SCALAR
+struct dsp_t {
+
+  // level this table was bound to
+  dsp_level_t level;
+
+  // expand mono samples into interleaved stereo
+  void (*mono_to_stereo)(const int16_t *in, int16_t *out, uint32_t samples);
+
+  // convert unsigned 8 bit wave data into signed 8 bit samples
+  void (*u8_to_s8)(const uint8_t *in, int8_t *out, uint32_t samples);
+
+  // mix count output samples of a mono 16 bit voice into out returning the
+  // new phase. these may read the frame after the one being played, so the
+  // caller must make sure that frame is within the sample.
+  phase_t (*resample_nearest)(const int16_t *data, phase_t phase, phase_t step,
+                              int16_t *out, uint32_t count);
+  phase_t (*resample_linear)(const int16_t *data, phase_t phase, phase_t step,
+                             int16_t *out, uint32_t count);
+
+  // sum of a[i] * b[i] for a count that is a multiple of 32
+  // the caller must keep the sum within 32 bits
+  int32_t (*dot_s16)(const int16_t *a, const int16_t *b, uint32_t count);
+};
+
+// return the kernels for the best level supported by this cpu
+// the TRACKER_SIMD environment variable (scalar, sse2, avx2 or avx512) can
+// force a lower level. the table is bound once on first use.
+const dsp_t &dsp();
+
+// bind the kernels for a specific level, returning false if this build or
+// this cpu does not support it
+bool dsp_bind(dsp_level_t level, dsp_t &out);
+
+// the best level supported by this build and cpu
+dsp_level_t dsp_detect();
+
+const char *dsp_level_name(dsp_level_t level);
+
+// per level binders, each one only fills in the kernels it implements and
+// returns false if the level was not compiled in
+bool dsp_bind_sse2(dsp_t &out);
+bool dsp_bind_avx2(dsp_t &out);
+bool dsp_bind_avx512(dsp_t &out);
+
+}  // namespace Tracker
@@ -0,0 +1,133 @@
+#include "dsp.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+
+namespace {
+
+using namespace Tracker;
+
+void mono_to_stereo_avx2(const int16_t *in, int16_t *out, uint32_t samples) {
+  uint32_t i = 0;
+  for (; i + 16 <= samples; i += 16) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+    // unpack works within 128 bit lanes so the halves need reordering
+    const __m256i lo = _mm256_unpacklo_epi16(v, v);
+    const __m256i hi = _mm256_unpackhi_epi16(v, v);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i * 2 + 0), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i * 2 + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+  for (; i < samples; ++i) {
+    out[i * 2 + 0] = in[i];
+    out[i * 2 + 1] = in[i];
+  }
+}
+
+void u8_to_s8_avx2(const uint8_t *in, int8_t *out, uint32_t samples) {
+  const __m256i bias = _mm256_set1_epi8(char(0x80));
+  uint32_t i = 0;
+  for (; i + 32 <= samples; i += 32) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_xor_si256(v, bias));
+  }
+  for (; i < samples; ++i) {
+    out[i] = int8_t(in[i] ^ 0x80);
+  }
+}
+
+// produce eight voice samples per iteration
+//
+// the phases of eight consecutive outputs are kept as two vectors of four
+// 64 bit values. a 32 bit gather at each index fetches the frame and the
+// one after it, which is all linear interpolation needs.
+template <bool LINEAR>
+phase_t resample_avx2(const int16_t *data, phase_t phase, phase_t step,
+                      int16_t *out, uint32_t count) {
+  uint32_t i = 0;
+  if (count >= 8) {
+    const __m256i steps = _mm256_set_epi64x(3 * step, 2 * step, step, 0);
+    const __m256i step4 = _mm256_set1_epi64x(int64_t(4 * step));
+    const __m256i step8 = _mm256_set1_epi64x(int64_t(8 * step));
+    __m256i p0 = _mm256_add_epi64(_mm256_set1_epi64x(int64_t(phase)), steps);
+    __m256i p1 = _mm256_add_epi64(p0, step4);
+    // select the odd (index) and even (fraction) 32 bit halves
+    const __m256i odd = _mm256_setr_epi32(1, 3, 5, 7, 1, 3, 5, 7);
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const __m256i level = _mm256_set1_epi32(12);
+    const int *base = reinterpret_cast<const int *>(data);
+    for (; i + 8 <= count; i += 8) {
+      const __m256i index = _mm256_permute2x128_si256(
+        _mm256_permutevar8x32_epi32(p0, odd), _mm256_permutevar8x32_epi32(p1, odd), 0x20);
+      const __m256i pair = _mm256_i32gather_epi32(base, index, 2);
+      // sign extend the frame in the low half of each lane
+      __m256i v = _mm256_srai_epi32(_mm256_slli_epi32(pair, 16), 16);
+      if (LINEAR) {
+        const __m256i frac = _mm256_srli_epi32(_mm256_permute2x128_si256(
+          _mm256_permutevar8x32_epi32(p0, even), _mm256_permutevar8x32_epi32(p1, even), 0x20), 17);
+        const __m256i next = _mm256_srai_epi32(pair, 16);
+        const __m256i delta = _mm256_mullo_epi32(_mm256_sub_epi32(next, v), frac);
+        v = _mm256_add_epi32(v, _mm256_srai_epi32(delta, 15));
+      }
+      v = _mm256_srai_epi32(_mm256_mullo_epi32(v, level), 8);
+      // voice levels are well within 16 bits so the saturating pack is exact
+      const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(v, v), 0x08);
+      __m128i *dst = reinterpret_cast<__m128i *>(out + i);
+      _mm_storeu_si128(dst, _mm_add_epi16(_mm_loadu_si128(dst), _mm256_castsi256_si128(packed)));
+      p0 = _mm256_add_epi64(p0, step8);
+      p1 = _mm256_add_epi64(p1, step8);
+    }
+    phase += phase_t(i) * step;
+  }
+  for (; i < count; ++i) {
+    const uint32_t index = uint32_t(phase >> PHASE_BITS);
+    int32_t v = data[index];
+    if (LINEAR) {
+      const int32_t frac = int32_t(uint32_t(phase) >> 17);
+      v = v + (((int32_t(data[index + 1]) - v) * frac) >> 15);
+    }
+    out[i] += (v * 12) >> 8;
+    phase += step;
+  }
+  return phase;
+}
+
+int32_t dot_s16_avx2(const int16_t *a, const int16_t *b, uint32_t count) {
+  __m256i sum = _mm256_setzero_si256();
+  for (uint32_t i = 0; i < count; i += 16) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, y));
+  }
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+  return _mm_cvtsi128_si32(s);
+}
+
+}  // namespace
+
+namespace Tracker {
+
+bool dsp_bind_avx2(dsp_t &out) {
+  out.mono_to_stereo = mono_to_stereo_avx2;
+  out.u8_to_s8 = u8_to_s8_avx2;
+  out.resample_nearest = resample_avx2<false>;
+  out.resample_linear = resample_avx2<true>;
+  out.dot_s16 = dot_s16_avx2;
+  return true;
+}
+
+}  // namespace Tracker
+
+#else
+
+namespace Tracker {
+
+bool dsp_bind_avx2(dsp_t &) {
+  return false;
+}
+
+}  // namespace Tracker
+
+#endif
@@ -0,0 +1,123 @@
+#include "dsp.h"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#include <immintrin.h>
+
+
+namespace {
+
+using namespace Tracker;
+
+void mono_to_stereo_avx512(const int16_t *in, int16_t *out, uint32_t samples) {
+  // duplicate each of the first and last 16 inputs of a 32 sample vector
+  const __m512i lo = _mm512_set_epi16(
+    15, 15, 14, 14, 13, 13, 12, 12, 11, 11, 10, 10, 9, 9, 8, 8,
+    7, 7, 6, 6, 5, 5, 4, 4, 3, 3, 2, 2, 1, 1, 0, 0);
+  const __m512i hi = _mm512_add_epi16(lo, _mm512_set1_epi16(16));
+  uint32_t i = 0;
+  for (; i + 32 <= samples; i += 32) {
+    const __m512i v = _mm512_loadu_si512(in + i);
+    _mm512_storeu_si512(out + i * 2 + 0, _mm512_permutexvar_epi16(lo, v));
+    _mm512_storeu_si512(out + i * 2 + 32, _mm512_permutexvar_epi16(hi, v));
+  }
+  for (; i < samples; ++i) {
+    out[i * 2 + 0] = in[i];
+    out[i * 2 + 1] = in[i];
+  }
+}
+
+void u8_to_s8_avx512(const uint8_t *in, int8_t *out, uint32_t samples) {
+  const __m512i bias = _mm512_set1_epi8(char(0x80));
+  uint32_t i = 0;
+  for (; i + 64 <= samples; i += 64) {
+    const __m512i v = _mm512_loadu_si512(in + i);
+    _mm512_storeu_si512(out + i, _mm512_xor_si512(v, bias));
+  }
+  for (; i < samples; ++i) {
+    out[i] = int8_t(in[i] ^ 0x80);
+  }
+}
+
+// sixteen voice samples per iteration, see resample_avx2 for the approach
+template <bool LINEAR>
+phase_t resample_avx512(const int16_t *data, phase_t phase, phase_t step,
+                        int16_t *out, uint32_t count) {
+  uint32_t i = 0;
+  if (count >= 16) {
+    const __m512i steps = _mm512_set_epi64(7 * step, 6 * step, 5 * step, 4 * step,
+                                           3 * step, 2 * step, step, 0);
+    const __m512i step8 = _mm512_set1_epi64(int64_t(8 * step));
+    const __m512i step16 = _mm512_set1_epi64(int64_t(16 * step));
+    __m512i p0 = _mm512_add_epi64(_mm512_set1_epi64(int64_t(phase)), steps);
+    __m512i p1 = _mm512_add_epi64(p0, step8);
+    const __m512i level = _mm512_set1_epi32(12);
+    for (; i + 16 <= count; i += 16) {
+      const __m512i index = _mm512_inserti64x4(
+        _mm512_castsi256_si512(_mm512_cvtepi64_epi32(_mm512_srli_epi64(p0, 32))),
+        _mm512_cvtepi64_epi32(_mm512_srli_epi64(p1, 32)), 1);
+      const __m512i pair = _mm512_i32gather_epi32(index, data, 2);
+      __m512i v = _mm512_srai_epi32(_mm512_slli_epi32(pair, 16), 16);
+      if (LINEAR) {
+        const __m512i frac = _mm512_srli_epi32(_mm512_inserti64x4(
+          _mm512_castsi256_si512(_mm512_cvtepi64_epi32(p0)), _mm512_cvtepi64_epi32(p1), 1), 17);
+        const __m512i next = _mm512_srai_epi32(pair, 16);
+        const __m512i delta = _mm512_mullo_epi32(_mm512_sub_epi32(next, v), frac);
+        v = _mm512_add_epi32(v, _mm512_srai_epi32(delta, 15));
+      }
+      v = _mm512_srai_epi32(_mm512_mullo_epi32(v, level), 8);
+      __m256i *dst = reinterpret_cast<__m256i *>(out + i);
+      _mm256_storeu_si256(dst, _mm256_add_epi16(_mm256_loadu_si256(dst), _mm512_cvtepi32_epi16(v)));
+      p0 = _mm512_add_epi64(p0, step16);
+      p1 = _mm512_add_epi64(p1, step16);
+    }
+    phase += phase_t(i) * step;
+  }
+  for (; i < count; ++i) {
+    const uint32_t index = uint32_t(phase >> PHASE_BITS);
+    int32_t v = data[index];
+    if (LINEAR) {
+      const int32_t frac = int32_t(uint32_t(phase) >> 17);
+      v = v + (((int32_t(data[index + 1]) - v) * frac) >> 15);
+    }
+    out[i] += (v * 12) >> 8;
+    phase += step;
+  }
+  return phase;
+}
+
+int32_t dot_s16_avx512(const int16_t *a, const int16_t *b, uint32_t count) {
+  __m512i sum = _mm512_setzero_si512();
+  for (uint32_t i = 0; i < count; i += 32) {
+    const __m512i x = _mm512_loadu_si512(a + i);
+    const __m512i y = _mm512_loadu_si512(b + i);
+    sum = _mm512_add_epi32(sum, _mm512_madd_epi16(x, y));
+  }
+  return _mm512_reduce_add_epi32(sum);
+}
+
+}  // namespace
+
+namespace Tracker {
+
+bool dsp_bind_avx512(dsp_t &out) {
+  out.mono_to_stereo = mono_to_stereo_avx512;
+  out.u8_to_s8 = u8_to_s8_avx512;
+  out.resample_nearest = resample_avx512<false>;
+  out.resample_linear = resample_avx512<true>;
+  out.dot_s16 = dot_s16_avx512;
+  return true;
+}
+
+}  // namespace Tracker
+
+#else
+
+namespace Tracker {
+
+bool dsp_bind_avx512(dsp_t &) {
+  return false;
+}
+
+}  // namespace Tracker
+
+#endif
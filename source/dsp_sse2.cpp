@@ -0,0 +1,72 @@
+#include "dsp.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+
+namespace {
+
+using namespace Tracker;
+
+void mono_to_stereo_sse2(const int16_t *in, int16_t *out, uint32_t samples) {
+  uint32_t i = 0;
+  for (; i + 8 <= samples; i += 8) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2 + 0), _mm_unpacklo_epi16(v, v));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2 + 8), _mm_unpackhi_epi16(v, v));
+  }
+  for (; i < samples; ++i) {
+    out[i * 2 + 0] = in[i];
+    out[i * 2 + 1] = in[i];
+  }
+}
+
+void u8_to_s8_sse2(const uint8_t *in, int8_t *out, uint32_t samples) {
+  const __m128i bias = _mm_set1_epi8(char(0x80));
+  uint32_t i = 0;
+  for (; i + 16 <= samples; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_xor_si128(v, bias));
+  }
+  for (; i < samples; ++i) {
+    out[i] = int8_t(in[i] ^ 0x80);
+  }
+}
+
+int32_t dot_s16_sse2(const int16_t *a, const int16_t *b, uint32_t count) {
+  __m128i sum = _mm_setzero_si128();
+  for (uint32_t i = 0; i < count; i += 8) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(x, y));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+  return _mm_cvtsi128_si32(sum);
+}
+
+}  // namespace
+
+namespace Tracker {
+
+// sse2 has no gather so resampling stays on the scalar kernels
+bool dsp_bind_sse2(dsp_t &out) {
+  out.mono_to_stereo = mono_to_stereo_sse2;
+  out.u8_to_s8 = u8_to_s8_sse2;
+  out.dot_s16 = dot_s16_sse2;
+  return true;
+}
+
+}  // namespace Tracker
+
+#else
+
+namespace Tracker {
+
+bool dsp_bind_sse2(dsp_t &) {
+  return false;
+}
+
+}  // namespace Tracker
+
+#endif
@@ -0,0 +1,145 @@
+#include <cstring>
+
+#include "engine.h"
+#include "tracker_c.h"
+#include "bank.h"
+
+
+namespace Tracker {
+
+engine_t::engine_t(uint32_t sample_rate)
+  : engine_t(sample_rate, sample_rate)
+{
+}
+
+engine_t::engine_t(uint32_t sample_rate, uint32_t engine_rate)
+  : _silence(UINT32_MAX)
+  , _cached(false)
+{
+  if (!_resampler.init(engine_rate, sample_rate)) {
+    _resampler.init(sample_rate, sample_rate);
+  }
+  _reset();
+}
+
+void engine_t::_reset() {
+  // the player holds a reference to the song so it goes first
+  _player.reset();
+  _song.reset(new song_t);
+  _player.reset(new player_t(*_song, engine_rate()));
+  _resampler.reset();
+  _silence = UINT32_MAX;
+  // cached patterns refer to the old song samples
+  _cached = false;
+  _cache.stop();
+  _cache.clear();
+}
+
+bool engine_t::load_song(const char *path) {
+  _reset();
+  return song_load(path, *_song);
+}
+
+bool engine_t::load_song(const char *path, const sample_loader_t &loader) {
+  _reset();
+  return song_load(path, *_song, loader);
+}
+
+bool engine_t::load_midi(const char *path, const bank_t &bank, smf_info_t &info) {
+  _reset();
+  if (!smf_load(path, *_song, info)) {
+    return false;
+  }
+  bank.apply(*_song);
+  return true;
+}
+
+void engine_t::play() {
+  _cached = false;
+  _cache.stop();
+  _resampler.reset();
+  _silence = 0;
+  _player->play_song();
+}
+
+void engine_t::play_cached() {
+  _player->stop();
+  _cached = true;
+  _resampler.reset();
+  _silence = 0;
+  _cache.start(*_song, engine_rate());
+}
+
+void engine_t::stop() {
+  // a stop cuts the song short, so there is no tail to drain
+  _silence = UINT32_MAX;
+  _player->stop();
+  _cache.stop();
+}
+
+uint32_t engine_t::render(int16_t *out, uint32_t frames) {
+  if (!playing()) {
+    return 0;
+  }
+  // once the song ends the resampler is fed silence until the last of it
+  // has passed through the filter
+  _resampler.pull(out, frames, [this](int16_t *in, uint32_t count) {
+    if (!_source_playing()) {
+      _silence += count;
+    }
+    else if (_cached) {
+      _cache.render(in, count);
+    }
+    else {
+      _player->render(in, count);
+    }
+  });
+  return frames;
+}
+
+}  // namespace Tracker
+
+struct tracker_engine_t {
+  explicit tracker_engine_t(uint32_t sample_rate)
+    : engine(sample_rate)
+  {
+  }
+  Tracker::engine_t engine;
+};
+
+extern "C" {
+
+tracker_engine_t *tracker_engine_create(uint32_t sample_rate) {
+  if (sample_rate == 0) {
+    return nullptr;
+  }
+  // exceptions must not cross into c code
+  try {
+    return new tracker_engine_t(sample_rate);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
+void tracker_engine_destroy(tracker_engine_t *engine) {
+  delete engine;
+}
+
+int tracker_engine_load_song(tracker_engine_t *engine, const char *path) {
+  if (!engine->engine.load_song(path)) {
+    return 0;
+  }
+  engine->engine.play();
+  return 1;
+}
+
+uint32_t tracker_engine_render(tracker_engine_t *engine, int16_t *out, uint32_t frames) {
+  return engine->engine.render(out, frames);
+}
+
+int tracker_engine_playing(const tracker_engine_t *engine) {
+  return engine->engine.playing() ? 1 : 0;
+}
+
+}  // extern "C"
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+
+#include "tracker.h"
+#include "song_io.h"
+#include "smf.h"
+#include "resampler.h"
+#include "render_cache.h"
+
+
+namespace Tracker {
+
+struct bank_t;
+
+// a song and a player to render it, for embedding the tracker in other
+// programs without the editor
+//
+// engines share no mutable state so any number of them may be rendered in
+// parallel, one thread per engine at a time. samples are immutable and may
+// be shared between engines through a sample_loader_t or bank_t.
+struct engine_t {
+
+  explicit engine_t(uint32_t sample_rate);
+
+  // run the player at engine_rate and resample its output to sample_rate,
+  // if the rates can not be converted the player runs at sample_rate
+  engine_t(uint32_t sample_rate, uint32_t engine_rate);
+
+  // replace the song with one loaded from a song file
+  bool load_song(const char *path);
+  bool load_song(const char *path, const sample_loader_t &loader);
+
+  // replace the song with one imported from a midi file using bank samples
+  bool load_midi(const char *path, const bank_t &bank, smf_info_t &info);
+
+  // play the song order list from the start
+  void play();
+  void stop();
+
+  // play the song order list from the start through the render cache, so
+  // patterns that have not changed since the last cached play are not
+  // rendered again. this suits rendering a song repeatedly while it is
+  // edited, see render_cache_t.
+  void play_cached();
+
+  // true while the song is playing, notes are still ringing out or the
+  // resampler has yet to output the end of them
+  bool playing() const {
+    return _source_playing() || _silence < _resampler.buffered();
+  }
+
+  // render mono audio into out, overwriting its contents
+  // returns frames, or zero once the song has finished and the resampler
+  // has passed its filter delay of up to resampler_t::TAPS engine frames.
+  // the last block of a song is padded with silence.
+  uint32_t render(int16_t *out, uint32_t frames);
+
+  // rate of the audio returned by render()
+  uint32_t sample_rate() const {
+    return _resampler.out_rate();
+  }
+
+  // rate the player runs at
+  uint32_t engine_rate() const {
+    return _resampler.in_rate();
+  }
+
+  // the song may only be edited while the engine is not rendering
+  song_t &song() {
+    return *_song;
+  }
+
+  player_t &player() {
+    return *_player;
+  }
+
+  render_cache_t &cache() {
+    return _cache;
+  }
+
+protected:
+  // start again with an empty song
+  void _reset();
+
+  // true while the player or render cache is producing audio
+  bool _source_playing() const {
+    return _cached ? _cache.playing() : _player->playing();
+  }
+
+  std::unique_ptr<song_t> _song;
+  std::unique_ptr<player_t> _player;
+  // final conversion from the engine rate to the output rate
+  resampler_t _resampler;
+  // engine frames of silence fed to the resampler since the song ended,
+  // UINT32_MAX when there is nothing left to drain
+  uint32_t _silence;
+  // true if play_cached() is playing rather than the player
+  bool _cached;
+  render_cache_t _cache;
+};
+
+}  // namespace Tracker
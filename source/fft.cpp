@@ -0,0 +1,51 @@
+#include <cmath>
+#include <utility>
+
+#include "fft.h"
+
+
+namespace Tracker {
+
+fft_t::fft_t(uint32_t size) {
+  _size = 1;
+  uint32_t bits = 0;
+  while (_size < size) {
+    _size <<= 1;
+    ++bits;
+  }
+  _reverse.resize(_size);
+  for (uint32_t i = 0; i < _size; ++i) {
+    uint32_t r = 0;
+    for (uint32_t b = 0; b < bits; ++b) {
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    _reverse[i] = r;
+  }
+  // e^(-2 pi i k / size) for the first half of the circle
+  _twiddle.resize(_size / 2);
+  for (uint32_t k = 0; k < _size / 2; ++k) {
+    const double a = -2.0 * 3.14159265358979323846 * double(k) / double(_size);
+    _twiddle[k] = std::complex<float>(float(cos(a)), float(sin(a)));
+  }
+}
+
+void fft_t::forward(std::complex<float> *data) const {
+  for (uint32_t i = 0; i < _size; ++i) {
+    if (i < _reverse[i]) {
+      std::swap(data[i], data[_reverse[i]]);
+    }
+  }
+  for (uint32_t len = 2; len <= _size; len <<= 1) {
+    const uint32_t half = len / 2;
+    const uint32_t stride = _size / len;
+    for (uint32_t i = 0; i < _size; i += len) {
+      for (uint32_t j = 0; j < half; ++j) {
+        const std::complex<float> t = _twiddle[j * stride] * data[i + j + half];
+        data[i + j + half] = data[i + j] - t;
+        data[i + j] += t;
+      }
+    }
+  }
+}
+
+}  // namespace Tracker
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <complex>
+#include <vector>
+
+
+namespace Tracker {
+
+// radix 2 complex fft of a fixed power of two size
+// the twiddles and bit reversal are computed once so transforms do not
+// allocate and may be run on any thread
+struct fft_t {
+
+  // size is rounded up to a power of two
+  explicit fft_t(uint32_t size);
+
+  // in place forward transform of size() values
+  void forward(std::complex<float> *data) const;
+
+  uint32_t size() const {
+    return _size;
+  }
+
+protected:
+  uint32_t _size;
+  std::vector<uint32_t> _reverse;
+  std::vector<std::complex<float>> _twiddle;
+};
+
+}  // namespace Tracker
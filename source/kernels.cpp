@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <type_traits>
+
+#include "kernels.h"
+#include "codec.h"
+#include "dsp.h"
+
+
+namespace {
+
+using namespace Tracker;
+
+enum {
+  // bits of the phase fraction used for linear interpolation
+  FRAC_BITS = 15,
+};
+
+// 8 bit mu-law data
+struct ulaw_t {
+  uint8_t value;
+};
+
+template <typename type_t>
+struct format_traits;
+
+template <>
+struct format_traits<int8_t> {
+  static int32_t decode(int8_t v) {
+    return int32_t(v) * (1 << 8);
+  }
+};
+
+template <>
+struct format_traits<int16_t> {
+  static int32_t decode(int16_t v) {
+    return v;
+  }
+};
+
+template <>
+struct format_traits<ulaw_t> {
+  static int32_t decode(ulaw_t v) {
+    return ulaw_decode(v.value);
+  }
+};
+
+// reads frames mixed to mono at 16 bits from uncompressed sample data
+template <typename type_t, uint32_t CHANNELS>
+struct frame_reader_t {
+
+  explicit frame_reader_t(const sample_t &sample)
+    : data(sample.get<type_t>())
+  {
+  }
+
+  int32_t operator()(uint32_t i) {
+    typedef format_traits<type_t> traits_t;
+    if (CHANNELS == 1) {
+      return traits_t::decode(data[i]);
+    }
+    return (traits_t::decode(data[i * 2]) + traits_t::decode(data[i * 2 + 1])) >> 1;
+  }
+
+  const type_t *data;
+};
+
+typedef frame_reader_t<int8_t, 1> s8_mono_t;
+typedef frame_reader_t<int8_t, 2> s8_stereo_t;
+typedef frame_reader_t<int16_t, 1> s16_mono_t;
+typedef frame_reader_t<int16_t, 2> s16_stereo_t;
+typedef frame_reader_t<ulaw_t, 1> ulaw_mono_t;
+typedef frame_reader_t<ulaw_t, 2> ulaw_stereo_t;
+
+// reads frames from adpcm data a block at a time
+//
+// the decoded block also holds the first frame of the next block, which
+// linear interpolation reads when playing the last frame of a block
+template <uint32_t CHANNELS>
+struct adpcm_reader_t {
+
+  explicit adpcm_reader_t(const sample_t &sample)
+    : sample(sample)
+    , block(~0u)
+  {
+  }
+
+  int32_t operator()(uint32_t i) {
+    const uint32_t b = i / ADPCM_BLOCK_FRAMES;
+    const uint32_t offset = i % ADPCM_BLOCK_FRAMES;
+    if (b != block) {
+      if (offset == 0 && b == block + 1 && block != ~0u) {
+        return frames[ADPCM_BLOCK_FRAMES];
+      }
+      decode(b);
+    }
+    return frames[offset];
+  }
+
+  void decode(uint32_t b) {
+    block = b;
+    const uint32_t first = b * ADPCM_BLOCK_FRAMES;
+    // one frame more than the block when there is a next block
+    const uint32_t count = std::min<uint32_t>(ADPCM_BLOCK_FRAMES + 1, sample.size - first);
+    const uint32_t in_block = std::min<uint32_t>(count, ADPCM_BLOCK_FRAMES);
+    int16_t temp[CHANNELS][ADPCM_BLOCK_FRAMES + 1];
+    for (uint32_t c = 0; c < CHANNELS; ++c) {
+      adpcm_decode(sample, b, c, temp[c], in_block);
+      if (count > in_block) {
+        adpcm_decode(sample, b + 1, c, temp[c] + ADPCM_BLOCK_FRAMES, 1);
+      }
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+      frames[i] = (CHANNELS == 1) ? temp[0][i] : ((int32_t(temp[0][i]) + temp[CHANNELS - 1][i]) >> 1);
+    }
+  }
+
+  const sample_t &sample;
+  // index of the decoded block
+  uint32_t block;
+  int32_t frames[ADPCM_BLOCK_FRAMES + 1];
+};
+
+// interpolate between two frames using the fractional part of the phase
+inline int32_t lerp(int32_t a, int32_t b, phase_t phase) {
+  const int32_t frac = int32_t(uint32_t(phase) >> (PHASE_BITS - FRAC_BITS));
+  return a + (((b - a) * frac) >> FRAC_BITS);
+}
+
+// scale a voice for mixing into the output stream
+inline int32_t mix_level(int32_t v) {
+  return (v * 12) >> 8;
+}
+
+template <typename reader_t, interp_t INTERP, loop_t LOOP>
+bool render_kernel(phase_t &phase, phase_t step, const sample_t &sample,
+                   uint32_t start, uint32_t end, int16_t *out, uint32_t samples) {
+  reader_t read{ sample };
+  end = std::min(end, sample.size);
+  const phase_t p_end = phase_t(end) << PHASE_BITS;
+  // linear interpolation reads one frame ahead so the fast loop has to
+  // stop one frame short of the end marker
+  const phase_t p_safe = (INTERP == INTERP_LINEAR) ?
+    (end ? (phase_t(end - 1) << PHASE_BITS) : 0) : p_end;
+
+  phase_t p = phase;
+  uint32_t done = 0;
+  while (done < samples) {
+    if (p < p_safe) {
+      // every read until p_safe is in bounds
+      const phase_t left = (p_safe - p + step - 1) / step;
+      const uint32_t count = uint32_t(std::min<phase_t>(left, samples - done));
+      int16_t *o = out + done;
+      uint32_t i = 0;
+      if (std::is_same<reader_t, s16_mono_t>::value) {
+        // the simd kernels always read the frame after the one played. that
+        // is in the sample padding at worst, but linear interpolation uses
+        // it so has to stop one frame short of the end marker.
+        const phase_t p_simd = (INTERP == INTERP_LINEAR) ? p_safe : p_end;
+        if (p < p_simd) {
+          static const dsp_t &ops = dsp();
+          const uint32_t n = uint32_t(std::min<phase_t>(count, (p_simd - p + step - 1) / step));
+          const int16_t *d = sample.get<int16_t>();
+          p = (INTERP == INTERP_LINEAR) ? ops.resample_linear(d, p, step, o, n) :
+                                          ops.resample_nearest(d, p, step, o, n);
+          i = n;
+        }
+      }
+      for (; i < count; ++i) {
+        const uint32_t index = uint32_t(p >> PHASE_BITS);
+        int32_t v = read(index);
+        if (INTERP == INTERP_LINEAR) {
+          v = lerp(v, read(index + 1), p);
+        }
+        o[i] += mix_level(v);
+        p += step;
+      }
+      done += count;
+      continue;
+    }
+    if (p < p_end) {
+      // last frame before the end marker interpolates towards the frame
+      // that will be played after it
+      const uint32_t index = uint32_t(p >> PHASE_BITS);
+      int32_t v = read(index);
+      if (INTERP == INTERP_LINEAR) {
+        const uint32_t next = (LOOP == LOOP_FORWARD && start < end) ? start : index;
+        v = lerp(v, read(next), p);
+      }
+      out[done++] += mix_level(v);
+      p += step;
+      continue;
+    }
+    if (LOOP == LOOP_FORWARD && start < end) {
+      // wrap back into the loop
+      const phase_t p_start = phase_t(start) << PHASE_BITS;
+      p = p_start + (p - p_start) % (p_end - p_start);
+      continue;
+    }
+    phase = p;
+    return true;
+  }
+  phase = p;
+  return false;
+}
+
+// read frames checking the layout at runtime
+struct generic_reader_t {
+
+  explicit generic_reader_t(const sample_t &sample)
+    : sample(sample)
+    , adpcm_mono(sample)
+    , adpcm_stereo(sample)
+  {
+  }
+
+  int32_t operator()(uint32_t i) {
+    const bool mono = (sample.channels == 1);
+    switch (sample.format) {
+    case SAMPLE_S8:
+      return mono ? s8_mono_t{ sample }(i) : s8_stereo_t{ sample }(i);
+    case SAMPLE_ULAW:
+      return mono ? ulaw_mono_t{ sample }(i) : ulaw_stereo_t{ sample }(i);
+    case SAMPLE_ADPCM:
+      // decoding a block per frame would be far too slow even here
+      return mono ? adpcm_mono(i) : adpcm_stereo(i);
+    default:
+      return mono ? s16_mono_t{ sample }(i) : s16_stereo_t{ sample }(i);
+    }
+  }
+
+  const sample_t &sample;
+  adpcm_reader_t<1> adpcm_mono;
+  adpcm_reader_t<2> adpcm_stereo;
+};
+
+#define KERNELS(READER)                                      \
+  {                                                          \
+    {                                                        \
+      render_kernel<READER, INTERP_NEAREST, LOOP_NONE>,      \
+      render_kernel<READER, INTERP_NEAREST, LOOP_FORWARD>,   \
+    },                                                       \
+    {                                                        \
+      render_kernel<READER, INTERP_LINEAR, LOOP_NONE>,       \
+      render_kernel<READER, INTERP_LINEAR, LOOP_FORWARD>,    \
+    },                                                       \
+  }
+
+// indexed by [format][channels - 1][interp][loop]
+const kernel_t kernels[NUM_SAMPLE_FORMATS][2][NUM_INTERP][NUM_LOOP] = {
+  { KERNELS(s8_mono_t), KERNELS(s8_stereo_t) },
+  { KERNELS(s16_mono_t), KERNELS(s16_stereo_t) },
+  { KERNELS(ulaw_mono_t), KERNELS(ulaw_stereo_t) },
+  { KERNELS(adpcm_reader_t<1>), KERNELS(adpcm_reader_t<2>) },
+};
+
+#undef KERNELS
+
+}  // namespace
+
+namespace Tracker {
+
+kernel_t select_kernel(sample_format_t format, uint32_t channels, interp_t interp, loop_t loop) {
+  const uint32_t c = std::min<uint32_t>(std::max<uint32_t>(channels, 1), 2) - 1;
+  return kernels[format][c][interp][loop];
+}
+
+bool render_generic(interp_t interp, loop_t loop, phase_t &phase, phase_t step,
+                    const sample_t &sample, uint32_t start, uint32_t end,
+                    int16_t *out, uint32_t samples) {
+  end = std::min(end, sample.size);
+  const bool looping = (loop == LOOP_FORWARD && start < end);
+  generic_reader_t read{ sample };
+  phase_t p = phase;
+  for (uint32_t i = 0; i < samples; ++i) {
+    uint32_t index = uint32_t(p >> PHASE_BITS);
+    if (index >= end) {
+      if (!looping) {
+        phase = p;
+        return true;
+      }
+      const phase_t p_start = phase_t(start) << PHASE_BITS;
+      p = p_start + (p - p_start) % ((phase_t(end) << PHASE_BITS) - p_start);
+      index = uint32_t(p >> PHASE_BITS);
+    }
+    int32_t v = read(index);
+    if (interp == INTERP_LINEAR) {
+      const uint32_t next = (index + 1 < end) ? (index + 1) : (looping ? start : index);
+      v = lerp(v, read(next), p);
+    }
+    out[i] += mix_level(v);
+    p += step;
+  }
+  phase = p;
+  return false;
+}
+
+}  // namespace Tracker
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+#include "tracker.h"
+
+
+namespace Tracker {
+
+// return the render kernel specialised for a sample layout and playback
+// mode, every combination is instantiated at compile time so the chosen
+// kernel carries no mode checks in its inner loop
+kernel_t select_kernel(sample_format_t format, uint32_t channels, interp_t interp, loop_t loop);
+
+// a single kernel that checks every mode for each output sample
+// this is the reference the specialised kernels must match exactly
+bool render_generic(interp_t interp, loop_t loop, phase_t &phase, phase_t step,
+                    const sample_t &sample, uint32_t start, uint32_t end,
+                    int16_t *out, uint32_t samples);
+
+}  // namespace Tracker
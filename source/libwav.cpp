@@ -8,10 +8,12 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 #include <algorithm>
 
 #include "libwav.h"
+#include "trace.h"
 
 #if !defined(_MSC_VER)
 #define PACK__ __attribute__((__packed__))
@@ -28,6 +30,7 @@ constexpr uint32_t fourcc(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
 
 enum {
   FMT_PCM = 1,
+  FMT_FLOAT = 3,
   FCC_RIFF = fourcc('R', 'I', 'F', 'F'),
   FCC_WAVE = fourcc('W', 'A', 'V', 'E'),
   FCC_FMT = fourcc('f', 'm', 't', ' '),
@@ -60,7 +63,11 @@ struct file_t {
 
   file_t(const char *path, const char *mode) : _fd(fopen(path, mode)) {}
 
-  ~file_t() { fclose(_fd); }
+  ~file_t() {
+    if (_fd) {
+      fclose(_fd);
+    }
+  }
 
   FILE *operator()() const { return _fd; }
 
@@ -81,6 +88,23 @@ protected:
 } // namespace
 
 bool wave_t::load(const char *path) {
+  return load_(path, true);
+}
+
+bool wave_t::load_info(const char *path, wave_info_t &info) {
+  wave_t wave;
+  if (!wave.load_(path, false)) {
+    return false;
+  }
+  info.samples = wave.num_frames();
+  info.channels = wave.num_channels();
+  info.depth = wave.bit_depth();
+  info.rate = wave.sample_rate();
+  return true;
+}
+
+bool wave_t::load_(const char *path, bool read_data) {
+  TRACE_ZONE("wave_t::load");
 
   file_t fd{ path, "rb" };
   if (!fd) {
@@ -123,8 +147,11 @@ bool wave_t::load(const char *path) {
 
   // parse a data chunk
   const auto on_data = [&](uint32_t id, uint32_t size) {
-    // read sample data
     sample_bytes_ = size;
+    if (!read_data) {
+      return true;
+    }
+    // read sample data
     samples_ = std::make_unique<uint8_t[]>(size);
     if (fread(samples_.get(), size, 1, fd()) != 1) {
       return false;
@@ -220,30 +247,25 @@ bool wave_t::save(const char *path) {
 bool wave_t::create(const wave_info_t &info) {
 
   // validate channel count
-  if (info.channels != 1 || info.channels != 2) {
+  if (info.channels != 1 && info.channels != 2) {
     return false;
   }
   channels_ = info.channels;
 
   // validate bit depth
-  if (info.depth != 8 || info.depth != 16) {
+  if (info.depth != 8 && info.depth != 16) {
     return false;
   }
   bit_depth_ = info.depth;
 
   // validate sample rate
-  switch (info.rate) {
-  case 44100:
-  case 22050:
-  case 11025:
-    break;
-  default:
+  if (info.rate < 8000 || info.rate > 192000) {
     return false;
   }
   sample_rate_ = info.rate;
 
   // allocate space for samples
-  sample_bytes_ = (info.depth / 8) * info.samples;
+  sample_bytes_ = size_t(info.depth / 8) * info.channels * info.samples;
   samples_ = std::make_unique<uint8_t[]>(sample_bytes_);
 
   return true;
@@ -269,3 +291,241 @@ int32_t wave_t::get_sample(uint32_t frame, uint32_t channel) const {
     return 0;
   }
 }
+
+namespace {
+
+// samples converted per fwrite by the writer
+const uint32_t WRITE_BLOCK = 4096;
+
+// largest size a riff chunk can hold before rf64 is needed
+const uint64_t RIFF_MAX = 0xffffffffull;
+
+// little endian header fields
+void put_u16(std::vector<uint8_t> &out, uint32_t v) {
+  out.push_back(uint8_t(v));
+  out.push_back(uint8_t(v >> 8));
+}
+
+void put_u32(std::vector<uint8_t> &out, uint32_t v) {
+  put_u16(out, v & 0xffff);
+  put_u16(out, v >> 16);
+}
+
+void put_u64(std::vector<uint8_t> &out, uint64_t v) {
+  put_u32(out, uint32_t(v));
+  put_u32(out, uint32_t(v >> 32));
+}
+
+void set_u32(std::vector<uint8_t> &out, size_t offset, uint32_t v) {
+  for (int i = 0; i < 4; ++i) {
+    out[offset + i] = uint8_t(v >> (i * 8));
+  }
+}
+
+void put_id(std::vector<uint8_t> &out, const char *id) {
+  out.insert(out.end(), id, id + 4);
+}
+
+uint32_t sample_bytes(wave_sample_t type) {
+  switch (type) {
+  case WAVE_PCM24:   return 3;
+  case WAVE_FLOAT32: return 4;
+  default:           return 2;
+  }
+}
+
+} // namespace
+
+bool wave_sample_parse(const char *name, wave_sample_t &type) {
+  if (strcmp(name, "s16") == 0) {
+    type = WAVE_PCM16;
+  }
+  else if (strcmp(name, "s24") == 0) {
+    type = WAVE_PCM24;
+  }
+  else if (strcmp(name, "f32") == 0) {
+    type = WAVE_FLOAT32;
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+wave_writer_t::wave_writer_t()
+  : fd_(nullptr), stream_(false), channels_(0), rate_(0), type_(WAVE_PCM16),
+  frames_(0), data_bytes_(0), error_(false) {}
+
+wave_writer_t::~wave_writer_t() {
+  close();
+}
+
+bool wave_writer_t::open(const char *path, uint32_t channels, uint32_t rate, wave_sample_t type) {
+  close();
+  if (channels != 1 && channels != 2) {
+    return false;
+  }
+  if (rate < 8000 || rate > 192000) {
+    return false;
+  }
+  FILE *fd = fopen(path, "wb");
+  if (!fd) {
+    return false;
+  }
+  return open_(fd, false, channels, rate, type);
+}
+
+bool wave_writer_t::open(FILE *stream, uint32_t channels, uint32_t rate, wave_sample_t type) {
+  close();
+  if (!stream || (channels != 1 && channels != 2)) {
+    return false;
+  }
+  if (rate < 8000 || rate > 192000) {
+    return false;
+  }
+  return open_(stream, true, channels, rate, type);
+}
+
+bool wave_writer_t::open_(FILE *fd, bool stream, uint32_t channels, uint32_t rate,
+                          wave_sample_t type) {
+  fd_ = fd;
+  stream_ = stream;
+  channels_ = channels;
+  rate_ = rate;
+  type_ = type;
+  frames_ = 0;
+  data_bytes_ = 0;
+  error_ = false;
+  // the header is written with zero sizes and patched on close
+  return write_header_(false);
+}
+
+bool wave_writer_t::write_header_(bool final) {
+  const uint32_t width = sample_bytes(type_);
+  const bool is_float = (type_ == WAVE_FLOAT32);
+  const uint64_t pad = data_bytes_ & 1;
+
+  std::vector<uint8_t> hdr;
+  // the riff size is patched once the header length is known
+  put_id(hdr, "RIFF");
+  put_u32(hdr, 0);
+  put_id(hdr, "WAVE");
+
+  // space for a ds64 chunk, left as junk unless the file needs rf64
+  put_id(hdr, "JUNK");
+  put_u32(hdr, 28);
+  const size_t ds64 = hdr.size();
+  hdr.resize(hdr.size() + 28, 0);
+
+  put_id(hdr, "fmt ");
+  put_u32(hdr, is_float ? 18 : 16);
+  put_u16(hdr, is_float ? FMT_FLOAT : FMT_PCM);
+  put_u16(hdr, channels_);
+  put_u32(hdr, rate_);
+  put_u32(hdr, rate_ * channels_ * width);
+  put_u16(hdr, channels_ * width);
+  put_u16(hdr, width * 8);
+  if (is_float) {
+    // cbSize, no extension
+    put_u16(hdr, 0);
+    // non pcm files carry their frame count in a fact chunk
+    put_id(hdr, "fact");
+    put_u32(hdr, 4);
+    put_u32(hdr, uint32_t(std::min<uint64_t>(frames_, RIFF_MAX)));
+  }
+
+  put_id(hdr, "data");
+  const size_t data_size = hdr.size();
+  put_u32(hdr, 0);
+
+  const uint64_t riff_size = uint64_t(hdr.size()) - 8 + data_bytes_ + pad;
+  if (stream_) {
+    // the length is not known yet and never will be patched
+    set_u32(hdr, 4, uint32_t(RIFF_MAX));
+    set_u32(hdr, data_size, uint32_t(RIFF_MAX));
+  }
+  else if (riff_size > RIFF_MAX) {
+    // rf64 keeps the real sizes in the ds64 chunk
+    memcpy(hdr.data(), "RF64", 4);
+    memcpy(hdr.data() + ds64 - 8, "ds64", 4);
+    std::vector<uint8_t> sizes;
+    put_u64(sizes, riff_size);
+    put_u64(sizes, data_bytes_);
+    put_u64(sizes, frames_);
+    put_u32(sizes, 0);
+    memcpy(hdr.data() + ds64, sizes.data(), sizes.size());
+    set_u32(hdr, 4, uint32_t(RIFF_MAX));
+    set_u32(hdr, data_size, uint32_t(RIFF_MAX));
+  }
+  else {
+    set_u32(hdr, 4, uint32_t(riff_size));
+    set_u32(hdr, data_size, uint32_t(data_bytes_));
+  }
+
+  if (final && fseek(fd_, 0, SEEK_SET) != 0) {
+    return false;
+  }
+  return fwrite(hdr.data(), hdr.size(), 1, fd_) == 1;
+}
+
+bool wave_writer_t::write(const int16_t *frames, uint32_t count) {
+  if (!fd_ || error_) {
+    return false;
+  }
+  const uint32_t width = sample_bytes(type_);
+  uint32_t samples = count * channels_;
+  while (samples) {
+    const uint32_t todo = std::min(samples, WRITE_BLOCK);
+    buffer_.resize(size_t(todo) * width);
+    uint8_t *dst = buffer_.data();
+    for (uint32_t i = 0; i < todo; ++i) {
+      const int16_t v = frames[i];
+      switch (type_) {
+      case WAVE_PCM16:
+        dst[0] = uint8_t(v);
+        dst[1] = uint8_t(uint16_t(v) >> 8);
+        break;
+      case WAVE_PCM24:
+        dst[0] = 0;
+        dst[1] = uint8_t(v);
+        dst[2] = uint8_t(uint16_t(v) >> 8);
+        break;
+      case WAVE_FLOAT32: {
+        const float f = float(v) / 32768.f;
+        memcpy(dst, &f, sizeof(f));
+        break;
+      }
+      }
+      dst += width;
+    }
+    if (fwrite(buffer_.data(), buffer_.size(), 1, fd_) != 1) {
+      error_ = true;
+      return false;
+    }
+    data_bytes_ += buffer_.size();
+    frames += todo;
+    samples -= todo;
+  }
+  frames_ += count;
+  return true;
+}
+
+bool wave_writer_t::close() {
+  if (!fd_) {
+    return false;
+  }
+  bool ok = !error_;
+  // chunks are word aligned
+  if (ok && (data_bytes_ & 1)) {
+    ok = fputc(0, fd_) != EOF;
+  }
+  if (stream_) {
+    ok = (fflush(fd_) == 0) && ok;
+  }
+  else {
+    ok = ok && write_header_(true);
+    ok = (fclose(fd_) == 0) && ok;
+  }
+  fd_ = nullptr;
+  return ok;
+}
@@ -7,8 +7,11 @@
 //
 
 #pragma once
+#include <cassert>
 #include <cstdint>
+#include <cstdio>
 #include <memory>
+#include <vector>
 
 struct wave_info_t {
   uint32_t samples;
@@ -23,6 +26,9 @@ struct wave_t {
   bool save(const char *path);
   bool load(const char *path);
 
+  // read only the headers of a wave file, skipping the sample data
+  static bool load_info(const char *path, wave_info_t &info);
+
   int32_t get_sample(uint32_t sample, uint32_t channel) const;
 
   uint32_t num_frames() const {
@@ -57,9 +63,63 @@ struct wave_t {
     channels_(0) {}
 
 protected:
+  bool load_(const char *path, bool read_data);
+
   size_t sample_bytes_;
   std::unique_ptr<uint8_t[]> samples_;
   uint32_t sample_rate_;
   uint32_t bit_depth_;
   uint32_t channels_;
 };
+
+enum wave_sample_t {
+  WAVE_PCM16,
+  WAVE_PCM24,
+  WAVE_FLOAT32,
+};
+
+// map a sample type name, s16, s24 or f32, to its wave_sample_t
+bool wave_sample_parse(const char *name, wave_sample_t &type);
+
+// appends blocks of audio to a wave file as they are produced so memory use
+// does not depend on the length of the file. the header sizes are patched
+// on close, switching to rf64 once the data passes 4gb.
+//
+// a wave may also be written to a stream that can not seek such as a pipe
+// or socket. the header then gives the riff and data sizes as 0xffffffff,
+// which streaming readers take to mean "until the end of the stream".
+struct wave_writer_t {
+
+  wave_writer_t();
+  ~wave_writer_t();
+
+  bool open(const char *path, uint32_t channels, uint32_t rate, wave_sample_t type);
+
+  // write to an open stream, which close() flushes but leaves open
+  bool open(FILE *stream, uint32_t channels, uint32_t rate, wave_sample_t type);
+
+  // append interleaved frames of 16 bit audio, converting to the file type
+  bool write(const int16_t *frames, uint32_t count);
+
+  // patch the header and close the file, returning false if any write failed
+  bool close();
+
+  bool is_open() const { return fd_ != nullptr; }
+
+  uint64_t frames() const { return frames_; }
+
+protected:
+  bool open_(FILE *fd, bool stream, uint32_t channels, uint32_t rate, wave_sample_t type);
+  bool write_header_(bool final);
+
+  FILE *fd_;
+  // true if fd_ belongs to the caller and can not seek
+  bool stream_;
+  uint32_t channels_;
+  uint32_t rate_;
+  wave_sample_t type_;
+  uint64_t frames_;
+  uint64_t data_bytes_;
+  bool error_;
+  std::vector<uint8_t> buffer_;
+};
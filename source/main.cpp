@@ -1,7 +1,8 @@
 #include <vector>
 #include <memory>
-#include <map>
+#include <unordered_map>
 #include <string>
+#include <deque>
 
 #define SDL_MAIN_HANDLED
 #include <SDL.h>
@@ -13,6 +14,18 @@
 
 #include "tracker.h"
 #include "libwav.h"
+#include "thread_pool.h"
+#include "bank.h"
+#include "sample_pool.h"
+#include "render_ahead.h"
+#include "song_io.h"
+#include "codec.h"
+#include "dsp.h"
+#include "resampler.h"
+#include "analysis.h"
+#include "tap.h"
+#include "fft.h"
+#include "trace.h"
 
 
 static int32_t _width = 1024;
@@ -23,22 +36,83 @@ static SDL_GLContext _context;
 
 static bool _active = true;
 
+// rate of the audio device
+static const uint32_t _output_rate = 44100;
+// rate the players run at, set with the TRACKER_RATE environment variable
+static uint32_t _engine_rate = _output_rate;
+// converts the engine rate to the output rate in the audio callback
+static Tracker::resampler_t _resampler;
+// the audio sent to the device, published for the output window
+static Tracker::tap_t _tap{ 1 << 16 };
+
 static std::unique_ptr<Tracker::song_t> _song;
 static std::unique_ptr<Tracker::player_t> _player;
+// plays notes from live input, it is rendered in the audio callback even
+// when _player is rendered ahead so that live notes are heard immediately
+static std::unique_ptr<Tracker::player_t> _live;
+// renders _player ahead of the audio device when running
+static std::unique_ptr<Tracker::render_ahead_t> _render_ahead;
 
 static int _gui_pattern = 0;
 static int _gui_instrument = 0;
+static char _gui_song_path[256] = "song.txt";
+
+// every sample file is loaded once and shared by the browser and instruments
+// unused samples are released once the pool is over its budget
+static Tracker::sample_pool_t _pool{ 256 << 20 };
+
+// a wave file found in the samples directory
+struct browser_entry_t {
+  std::string path;
+  // read from the file header, the samples are loaded on first use
+  wave_info_t info;
+};
+
+static std::vector<browser_entry_t> _browser;
+
+// a sample prepared by the worker waiting to be installed in an instrument
+struct sample_ready_t {
+  int instrument;
+  std::shared_ptr<const Tracker::sample_t> sample;
+  // true if the sample is a new encoding of the current one
+  bool keep_markers;
+  // set up the instrument from the analysis if there is one
+  bool analysed;
+  Tracker::sample_analysis_t analysis;
+};
+
+static std::mutex _ready_mutex;
+static std::deque<sample_ready_t> _ready;
 
-static std::map<std::string, wave_t> _samples;
+// samples replaced while the audio thread may still be using them
+static Tracker::sample_bin_t _sample_bin;
+
+// builds samples off the ui and audio threads
+// a single thread keeps assignments in the order they were requested
+static thread_pool_t _worker{ 1 };
+
+// analysis of the sample assigned to each instrument, if it has one
+static std::array<bool, Tracker::MAX_INSTUMENTS> _ins_analysed;
+static std::array<Tracker::sample_analysis_t, Tracker::MAX_INSTUMENTS> _ins_analysis;
+
+// analysis of the whole sample library, results are cached next to each
+// file so a library is only analysed once
+static thread_pool_t _analysis_pool{ std::max(std::thread::hardware_concurrency(), 1u) };
+static std::atomic<uint32_t> _analysis_pending{ 0 };
+static std::mutex _analysed_mutex;
+static std::unordered_map<std::string, Tracker::sample_analysis_t> _analysed;
 
 
 void audio_callback(void *user, uint8_t *data, int size) {
+  TRACE_THREAD("audio");
+  TRACE_ZONE("audio_callback");
   memset(data, 0, size);
 
   if (!_player) {
     return;
   }
 
+  const bool ahead = _render_ahead->running();
   std::array<int16_t, 1024> temp;
 
   // number of samples we need total
@@ -50,15 +124,21 @@ void audio_callback(void *user, uint8_t *data, int size) {
   while (samples) {
     // number of samples we can do in one sitting
     const uint32_t todo = std::min<uint32_t>(samples, uint32_t(temp.size()));
-    // render from the player
-    temp.fill(0);
-    _player->render(temp.data(), todo);
+    // render from the players at the engine rate
+    _resampler.pull(temp.data(), todo, [ahead](int16_t *in, uint32_t frames) {
+      if (ahead) {
+        // frames that are not ready yet are left silent
+        _render_ahead->read(in, frames);
+      }
+      else {
+        _player->render(in, frames);
+      }
+      _live->render_notes(in, frames);
+    });
+    _tap.write(temp.data(), todo);
     // render to mono for the output stream
-    for (uint32_t i = 0; i < todo; ++i) {
-      out[0] = temp[i];
-      out[1] = temp[i];
-      out += 2;
-    }
+    Tracker::dsp().mono_to_stereo(temp.data(), out, todo);
+    out += todo * 2;
     samples -= todo;
   }
 }
@@ -71,7 +151,7 @@ bool audio_init() {
 
   desired.size = sizeof(desired);
   desired.channels = 2;
-  desired.freq = 44100;
+  desired.freq = _output_rate;
   desired.samples = 1024*4;  // ~100ms
   desired.format = AUDIO_S16SYS;
   desired.callback = audio_callback;
@@ -127,78 +207,272 @@ bool app_events() {
 }
 
 void load_samples() {
-  _samples.clear();
+  _browser.clear();
   WIN32_FIND_DATAA find;
   HANDLE handle = FindFirstFileA("./samples/*.wav", &find);
   if (handle == INVALID_HANDLE_VALUE) {
     return;
   }
   do {
-    std::string name = std::string("./samples/") + find.cFileName;
-    wave_t wave;
-    if (wave.load(name.c_str())) {
-      _samples[name] = std::move(wave);
+    browser_entry_t entry;
+    entry.path = std::string("./samples/") + find.cFileName;
+    if (wave_t::load_info(entry.path.c_str(), entry.info)) {
+      _browser.push_back(std::move(entry));
     }
   } while (FindNextFileA(handle, &find));
 }
 
+// queue a sample for installation, this may be called from any thread
+void sample_ready(int instrument, std::shared_ptr<const Tracker::sample_t> sample,
+                  bool keep_markers = false,
+                  const Tracker::sample_analysis_t *analysis = nullptr) {
+  std::lock_guard<std::mutex> guard{ _ready_mutex };
+  _ready.push_back(sample_ready_t{ instrument, std::move(sample), keep_markers,
+    analysis != nullptr, analysis ? *analysis : Tracker::sample_analysis_t() });
+}
+
+// analyse every file in the browser on the analysis pool
+void analyse_library() {
+  for (const auto &entry : _browser) {
+    const std::string path = entry.path;
+    const wave_info_t info = entry.info;
+    ++_analysis_pending;
+    _analysis_pool.push([path, info]() {
+      Tracker::sample_analysis_t a;
+      bool ok = Tracker::analysis_load(path, info, a);
+      if (!ok) {
+        // bypass the pool so a library pass does not evict working samples
+        if (auto sample = Tracker::sample_load(path.c_str())) {
+          Tracker::sample_analyse(*sample, a);
+          Tracker::analysis_save(path, info, a);
+          ok = true;
+        }
+      }
+      if (ok) {
+        std::lock_guard<std::mutex> guard{ _analysed_mutex };
+        _analysed[path] = a;
+      }
+      --_analysis_pending;
+    });
+  }
+}
+
+// install any samples that are ready
+void install_samples() {
+  std::deque<sample_ready_t> ready;
+  {
+    std::lock_guard<std::mutex> guard{ _ready_mutex };
+    ready.swap(_ready);
+  }
+  for (auto &r : ready) {
+    auto &ins = _song->instruments[r.instrument];
+    if (!r.keep_markers) {
+      ins.sample_start = 0;
+      ins.sample_end = r.sample->size;
+      _ins_analysed[r.instrument] = r.analysed;
+      _ins_analysis[r.instrument] = r.analysis;
+    }
+    if (r.analysed && !r.keep_markers) {
+      const auto &a = r.analysis;
+      ins.sample_start = a.start;
+      ins.sample_end = a.end;
+      if (a.pitched) {
+        ins.root = uint8_t(a.root);
+        ins.fine = a.fine;
+      }
+    }
+    // the audio thread picks up the new sample on its next block
+    _sample_bin.retire({ _player.get(), _live.get() }, ins.set_sample(std::move(r.sample)));
+  }
+  // release samples the audio thread has finished with
+  _sample_bin.collect({ _player.get(), _live.get() });
+}
+
 void visit_samples() {
+  TRACE_ZONE("visit_samples");
   ImGui::Begin("Samples");
-  ImGui::BeginChild("SamplesScrollBox");
-  for (const auto &s : _samples) {
-    if (!ImGui::Selectable(s.first.c_str())) {
-      continue;
+  ImGui::Text("%d loaded, %d KB", int(_pool.size()), int(_pool.bytes() / 1024));
+  if (const uint32_t pending = _analysis_pending.load()) {
+    ImGui::Text("Analysing, %d files left", int(pending));
+  }
+  else if (ImGui::Button("Analyse Library")) {
+    analyse_library();
+  }
+  {
+    int budget = int(_pool.budget() >> 20);
+    if (ImGui::SliderInt("Cache MB", &budget, 16, 4096)) {
+      _pool.set_budget(size_t(budget) << 20);
     }
-    const auto &sample = s.second;
+  }
+  ImGui::BeginChild("SamplesScrollBox");
+  for (const auto &s : _browser) {
+    // files that are not in memory are marked with a *
+    char root[16] = "";
     {
-      uint32_t sample_size = sample.num_frames();
-
-      std::lock_guard<std::mutex> guard{ _player->mutex() };
-      auto &ins = _song->instruments[_gui_instrument];
-      ins.sample.data.reset(new int16_t[sample_size]);
-      ins.sample_start = 0;
-      ins.sample_end = sample_size;
-      ins.sample.size = sample_size;
-      ins.sample.sample_rate = sample.sample_rate();
-      // copy over the sample
-      for (int i = 0; i < sample_size; ++i) {
-        ins.sample.data[i] = sample.get_sample(i, 0);
+      std::lock_guard<std::mutex> guard{ _analysed_mutex };
+      auto itt = _analysed.find(s.path);
+      if (itt != _analysed.end() && itt->second.pitched) {
+        snprintf(root, sizeof(root), " root %u", itt->second.root);
       }
     }
+    char label[512];
+    snprintf(label, sizeof(label), "%s  %.2fs %ubit %s%s%s", s.path.c_str(),
+      s.info.rate ? float(s.info.samples) / s.info.rate : 0.f, s.info.depth,
+      (s.info.channels == 2) ? "stereo" : "mono", root, _pool.contains(s.path) ? "" : " *");
+    if (!ImGui::Selectable(label)) {
+      continue;
+    }
+    // load on the worker if the pool does not hold the sample already,
+    // the instrument then shares the pooled sample so nothing is copied
+    const std::string path = s.path;
+    const int instrument = _gui_instrument;
+    _worker.push([path, instrument]() {
+      auto sample = _pool.get(path);
+      if (sample) {
+        // the instrument is tuned and trimmed from the cached analysis
+        Tracker::sample_analysis_t analysis;
+        Tracker::sample_analysis_get(*sample, analysis);
+        sample_ready(instrument, std::move(sample), false, &analysis);
+      }
+    });
   }
   ImGui::EndChild();
   ImGui::End();
 }
 
+// waveform view state for the instrument editor
+struct wave_view_t {
+
+  wave_view_t()
+    : sample(nullptr)
+    , start(0)
+    , length(0)
+  {
+  }
+
+  // the sample the view was last fitted to
+  const Tracker::sample_t *sample;
+  // visible range in samples
+  uint32_t start;
+  uint32_t length;
+  // per pixel min/max taken from the peak pyramid
+  std::vector<Tracker::peaks_t::bin_t> bins;
+};
+
+static wave_view_t _wave_view;
+
+// draw the instrument waveform with its markers
+// mouse wheel zooms around the cursor, shift+wheel scrolls, left click
+// sets the sample start and right click sets the sample end
+void visit_waveform(Tracker::instrument_t &ins, const Tracker::sample_t *sample) {
+  TRACE_ZONE("visit_waveform");
+  auto &view = _wave_view;
+  const ImVec2 pos = ImGui::GetCursorScreenPos();
+  const ImVec2 size = ImVec2{ std::max(ImGui::GetContentRegionAvail().x, 64.f), 96.f };
+  ImGui::InvisibleButton("Waveform", size);
+  ImDrawList* Draw = ImGui::GetWindowDrawList();
+  Draw->AddRectFilled(pos, ImVec2{ pos.x + size.x, pos.y + size.y }, 0xff202020);
+
+  if (!sample || sample->size == 0) {
+    view.sample = nullptr;
+    return;
+  }
+  // show the whole sample when it changes
+  if (view.sample != sample) {
+    view.sample = sample;
+    view.start = 0;
+    view.length = sample->size;
+  }
+
+  const ImGuiIO& IO = ImGui::GetIO();
+  const uint32_t width = uint32_t(size.x);
+  const float spp = float(view.length) / float(width);
+  // sample under the mouse cursor
+  const float mx = std::max(0.f, std::min(IO.MousePos.x - pos.x, size.x));
+  const uint32_t cursor = std::min(sample->size - 1, view.start + uint32_t(mx * spp));
+
+  if (ImGui::IsItemHovered()) {
+    if (IO.MouseWheel != 0.f) {
+      if (IO.KeyShift) {
+        const int64_t delta = int64_t(-IO.MouseWheel * float(view.length) / 8.f);
+        view.start = uint32_t(std::max<int64_t>(0, int64_t(view.start) + delta));
+      }
+      else {
+        // zoom keeping the sample under the cursor fixed
+        const float scale = (IO.MouseWheel > 0.f) ? .5f : 2.f;
+        const uint32_t length = uint32_t(std::max(float(width), float(view.length) * scale));
+        view.length = std::min(length, sample->size);
+        view.start = uint32_t(std::max(0.f, float(cursor) - mx * float(view.length) / float(width)));
+      }
+      view.start = std::min(view.start, sample->size - view.length);
+    }
+    if (IO.MouseClicked[0]) {
+      ins.sample_start = cursor;
+    }
+    if (IO.MouseClicked[1]) {
+      ins.sample_end = cursor;
+    }
+  }
+
+  view.bins.resize(width);
+  sample->peaks.query(*sample, view.start, view.start + view.length, width, view.bins.data());
+
+  const float mid = pos.y + size.y * .5f;
+  const float scale = size.y * .5f / 32768.f;
+  for (uint32_t i = 0; i < width; ++i) {
+    const auto &bin = view.bins[i];
+    const float x = pos.x + float(i);
+    Draw->AddLine(ImVec2{ x, mid - float(bin.max) * scale },
+                  ImVec2{ x, mid - float(bin.min) * scale + 1.f }, 0xffc0c0c0);
+  }
+
+  // draw the markers if they are in view
+  const auto marker = [&](uint32_t at, uint32_t rgb) {
+    if (at < view.start || at >= view.start + view.length) {
+      return;
+    }
+    const float x = pos.x + float(at - view.start) / spp;
+    Draw->AddLine(ImVec2{ x, pos.y }, ImVec2{ x, pos.y + size.y }, rgb);
+  };
+  marker(ins.sample_start, 0xff00ff00);
+  marker(ins.sample_end, 0xff0000ff);
+}
+
 void visit_instrument() {
+  TRACE_ZONE("visit_instrument");
   if (!_song) {
     return;
   }
   auto &ins = _song->instruments[_gui_instrument];
   ImGui::Begin("Instrument");
   if (ImGui::Button("Generate")) {
-    std::lock_guard<std::mutex> guard{ _player->mutex() };
-    auto &s = ins.sample;
-    s.size = 11050 * 4;
-    s.data.reset(new int16_t[s.size]);
-    s.sample_rate = 22050;
-    float x = 0.f;
-    float step = 2.f * float(M_PI) / (s.sample_rate / 440);
-    for (uint32_t i = 0; i < s.size; ++i) {
-      s.data[i] = int16_t(sinf(x) * 0x1fff);
-      x += step;
-    }
-    ins.sample_start = 0;
-    ins.sample_end = s.size;
+    const int instrument = _gui_instrument;
+    _worker.push([instrument]() {
+      auto s = std::make_shared<Tracker::sample_t>();
+      s->sample_rate = 22050;
+      s->alloc(11050 * 4);
+      int16_t *data = s->get<int16_t>();
+      float x = 0.f;
+      float step = 2.f * float(M_PI) / (s->sample_rate / 440);
+      for (uint32_t i = 0; i < s->size; ++i) {
+        data[i] = int16_t(sinf(x) * 0x1fff);
+        x += step;
+      }
+      s->peaks.build(*s);
+      sample_ready(instrument, std::move(s));
+    });
   }
+  const Tracker::sample_t *sample = ins.sample();
+  const int sample_size = sample ? int(sample->size) : 0;
+  visit_waveform(ins, sample);
   {
     int ss = ins.sample_start;
-    ImGui::SliderInt("Sample Start", &ss, 0, ins.sample.size-1);
+    ImGui::SliderInt("Sample Start", &ss, 0, sample_size-1);
     ins.sample_start = ss;
   }
   {
     int se = ins.sample_end;
-    ImGui::SliderInt("Sample End", &se, 0, ins.sample.size-1);
+    ImGui::SliderInt("Sample End", &se, 0, sample_size-1);
     ins.sample_end = se;
   }
   {
@@ -210,86 +484,268 @@ void visit_instrument() {
     ImGui::SliderFloat("Fine", &ins.fine, -1.f, 1.f);
   }
   {
-    ImGui::Text("Sample Rate %d", int(ins.sample.sample_rate));
+    static const char *names[] = { "Nearest", "Linear" };
+    int interp = ins.interp;
+    ImGui::Combo("Interpolation", &interp, names, Tracker::NUM_INTERP);
+    ins.interp = Tracker::interp_t(interp);
+  }
+  {
+    static const char *names[] = { "Off", "Forward" };
+    int loop = ins.loop;
+    ImGui::Combo("Loop", &loop, names, Tracker::NUM_LOOP);
+    ins.loop = Tracker::loop_t(loop);
+  }
+  if (sample) {
+    // store the sample in another format to trade quality for memory
+    static const char *names[] = { "8 Bit", "16 Bit", "Mu-Law", "ADPCM" };
+    int format = sample->format;
+    if (ImGui::Combo("Encoding", &format, names, Tracker::NUM_SAMPLE_FORMATS) &&
+        format != sample->format) {
+      auto source = ins.sample_ref();
+      const int instrument = _gui_instrument;
+      _worker.push([source, format, instrument]() {
+        auto s = Tracker::sample_encode(*source, Tracker::sample_format_t(format));
+        sample_ready(instrument, std::move(s), true);
+      });
+    }
+  }
+  if (sample && _ins_analysed[_gui_instrument]) {
+    const auto &a = _ins_analysis[_gui_instrument];
+    if (a.pitched) {
+      ImGui::Text("Detected Root %u Fine %+.3f", a.root, a.fine);
+    }
+    else {
+      ImGui::Text("No Pitch Detected");
+    }
+    ImGui::Text("Peak %.1f dB RMS %.1f dB", a.peak_db, a.rms_db);
+    if (a.loopable && ImGui::Button("Use Detected Loop")) {
+      ins.sample_start = a.loop_start;
+      ins.sample_end = a.loop_end;
+      ins.loop = Tracker::LOOP_FORWARD;
+    }
+  }
+  {
+    ImGui::Text("Sample Rate %d", sample ? int(sample->sample_rate) : 0);
+    ImGui::Text("Sample Memory %d KB", sample ? int(sample->bytes() / 1024) : 0);
   }
   ImGui::End();
 }
 
 std::array<int, 12> key_rgb = { 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 1 };
 
+enum {
+  // grid columns per beat
+  PATTERN_COLS_PER_BEAT = 4,
+  PATTERN_COLS = Tracker::BEATS_IN_PATTERN * PATTERN_COLS_PER_BEAT,
+  PATTERN_ROWS = 128,
+};
+
+// pattern editor view state
+struct pattern_view_t {
+
+  pattern_view_t()
+    : size(8.f)
+    , scroll_x(0.f)
+    , scroll_y(0.f)
+    , grid_size(0.f)
+    , grid_scroll_x(-1.f)
+    , grid_scroll_y(-1.f)
+    , index_pattern(-1)
+    , index_revision(0)
+  {
+  }
+
+  // size of a grid cell in pixels
+  float size;
+  // scroll position in grid cells
+  float scroll_x;
+  float scroll_y;
+
+  struct row_t {
+    float y;
+    uint32_t rgb;
+  };
+
+  struct col_t {
+    float x;
+    uint32_t rgb;
+  };
+
+  // visible grid geometry relative to the view origin, rebuilt only when
+  // the zoom, scroll position or view area changes
+  std::vector<row_t> rows;
+  std::vector<col_t> cols;
+  float grid_size;
+  float grid_scroll_x;
+  float grid_scroll_y;
+  ImVec2 grid_area;
+
+  // (column, note, instrument) to note index for hit testing, rebuilt only
+  // when the pattern changes
+  std::unordered_map<uint32_t, uint32_t> index;
+  int index_pattern;
+  uint32_t index_revision;
+
+  static uint32_t key(int32_t col, int32_t note, int32_t instrument) {
+    return (uint32_t(col) << 16) | (uint32_t(note & 0xff) << 8) | uint32_t(instrument & 0xff);
+  }
+
+  void update_grid(const ImVec2 &area) {
+    if (grid_size == size && grid_scroll_x == scroll_x && grid_scroll_y == scroll_y &&
+        grid_area.x == area.x && grid_area.y == area.y) {
+      return;
+    }
+    grid_size = size;
+    grid_scroll_x = scroll_x;
+    grid_scroll_y = scroll_y;
+    grid_area = area;
+    rows.clear();
+    cols.clear();
+    // only the rows and columns inside the view area are kept
+    const int32_t r0 = std::max(0, int32_t(scroll_y));
+    const int32_t r1 = std::min<int32_t>(PATTERN_ROWS - 1, int32_t(scroll_y + area.y / size) + 1);
+    for (int32_t i = r0; i <= r1; ++i) {
+      int k = (11 - ((i + 1) % 12));
+      uint32_t rgb = (k == 0) ? 0x80808080 : (key_rgb[k] ? 0x80404040 : 0x80808080);
+      rows.push_back(row_t{ (float(i) - scroll_y) * size, rgb });
+    }
+    const int32_t c0 = std::max(0, int32_t(scroll_x));
+    const int32_t c1 = std::min<int32_t>(PATTERN_COLS, int32_t(scroll_x + area.x / size) + 1);
+    for (int32_t i = c0; i <= c1; ++i) {
+      uint32_t rgb = (i & 7) ? 0x40ffffff : 0x80ffffff;
+      cols.push_back(col_t{ (float(i) - scroll_x) * size, rgb });
+    }
+  }
+
+  void update_index(int pattern, const Tracker::pattern_t &pat) {
+    if (index_pattern == pattern && index_revision == pat.revision) {
+      return;
+    }
+    index_pattern = pattern;
+    index_revision = pat.revision;
+    index.clear();
+    for (uint32_t i = 0; i < pat.notes_head; ++i) {
+      const auto &n = pat.notes[i];
+      const int32_t col = int32_t(n.start * PATTERN_COLS_PER_BEAT + .5f);
+      index[key(col, n.note, n.instrument)] = i;
+    }
+  }
+
+  // find the note under a grid cell or return -1
+  int32_t find(int32_t col, int32_t note, int32_t instrument) const {
+    auto itt = index.find(key(col, note, instrument));
+    return (itt == index.end()) ? -1 : int32_t(itt->second);
+  }
+};
+
+static pattern_view_t _pattern_view;
+
 void visit_pattern() {
+  TRACE_ZONE("visit_pattern");
   if (!_song) {
     return;
   }
   auto &pat = _song->patterns[_gui_pattern];
+  auto &view = _pattern_view;
   ImGui::Begin("Pattern");
 
-  ImGui::BeginChild("Hello There");
+  ImGui::BeginChild("Hello There", ImVec2{ 0, 0 }, false, ImGuiWindowFlags_NoScrollWithMouse);
 
-  const ImGuiStyle& Style = ImGui::GetStyle();
   const ImGuiIO& IO = ImGui::GetIO();
   ImDrawList* Draw = ImGui::GetWindowDrawList();
 
   const ImVec2 pos = ImGui::GetCursorScreenPos();
   const ImVec2 area = ImGui::GetContentRegionAvail();
+  const bool hovered = ImGui::IsWindowHovered();
 
-  float size = 8.f;
+  // mouse wheel scrolls vertically, shift+wheel horizontally, ctrl+wheel zooms
+  if (hovered && IO.MouseWheel != 0.f) {
+    if (IO.KeyCtrl) {
+      view.size = std::min(32.f, std::max(4.f, view.size + IO.MouseWheel));
+    }
+    else if (IO.KeyShift) {
+      view.scroll_x -= IO.MouseWheel * 4.f;
+    }
+    else {
+      view.scroll_y -= IO.MouseWheel * 4.f;
+    }
+  }
+  const float size = view.size;
+  view.scroll_x = std::max(0.f, std::min(view.scroll_x, float(PATTERN_COLS) - area.x / size));
+  view.scroll_y = std::max(0.f, std::min(view.scroll_y, float(PATTERN_ROWS) - area.y / size));
 
-  const float areax = std::min(area.x, 64.f * size);
-  const float areay = std::min(area.y, 128 * size);
+  const float areax = std::min(area.x, (float(PATTERN_COLS) - view.scroll_x) * size);
+  const float areay = std::min(area.y, (float(PATTERN_ROWS) - view.scroll_y) * size);
 
   const float minx = pos.x;
   const float maxx = pos.x + areax;
   const float miny = pos.y;
   const float maxy = pos.y + areay;
 
-  int i = 0;
-  for (float y = miny; y <= maxy; y += size, ++i) {
-    int k = (11 - ((i + 1) % 12));
-    uint32_t rgb = (k == 0) ? 0x80808080 : (key_rgb[k] ? 0x80404040 : 0x80808080);
-    Draw->AddRectFilled(ImVec2{ minx, y-3 }, ImVec2{ maxx, y+3 }, rgb);
-  }
+  Draw->PushClipRect(ImVec2{ minx, miny }, ImVec2{ maxx, maxy }, true);
 
-  i = 0;
-  for (float x = minx; x <= maxx; x += size, ++i) {
-    uint32_t rgb = (i & 7) ? 0x40ffffff : 0x80ffffff;
-    Draw->AddLine(ImVec2{ x, miny }, ImVec2{ x, maxy }, rgb);
+  view.update_grid(ImVec2{ areax, areay });
+  for (const auto &r : view.rows) {
+    const float y = miny + r.y;
+    Draw->AddRectFilled(ImVec2{ minx, y-3 }, ImVec2{ maxx, y+3 }, r.rgb);
+  }
+  for (const auto &c : view.cols) {
+    const float x = minx + c.x;
+    Draw->AddLine(ImVec2{ x, miny }, ImVec2{ x, maxy }, c.rgb);
   }
 
-  {
-    const ImVec2 pos = ImGui::GetCursorScreenPos();
-    const int32_t ix = int32_t((IO.MousePos.x - minx + (size / 2)) / size);
-    const int32_t iy = int32_t((IO.MousePos.y - miny + (size / 2)) / size);
-    ImVec2 p = ImVec2{ minx + float(ix) * size, miny + float(iy) * size };
-    Draw->AddCircle(p, size / 2.f, 0xff335577);
+  // grid cell under the mouse
+  const int32_t ix = int32_t(std::floor((IO.MousePos.x - minx + (size / 2)) / size + view.scroll_x));
+  const int32_t iy = int32_t(std::floor((IO.MousePos.y - miny + (size / 2)) / size + view.scroll_y));
+
+  view.update_index(_gui_pattern, pat);
+  const int32_t under = view.find(ix, 127 - iy, _gui_instrument);
+
+  if (hovered) {
+    ImVec2 p = ImVec2{ minx + (float(ix) - view.scroll_x) * size, miny + (float(iy) - view.scroll_y) * size };
+    Draw->AddCircle(p, size / 2.f, (under >= 0) ? 0xff77aaff : 0xff335577);
   }
 
-  for (int i = 0; i < pat.notes_head; ++i) {
-    const auto &note = pat.notes[i];
-    const float x = note.start * size * 4.f;
-    const float y = float(127 - (note.note)) * size;
+  {
+    // visible time window in beats and pitch window in semitones
+    const float beat0 = (view.scroll_x - .5f) / PATTERN_COLS_PER_BEAT;
+    const float beat1 = (view.scroll_x + areax / size + .5f) / PATTERN_COLS_PER_BEAT;
+    const int32_t note_hi = 127 - int32_t(view.scroll_y - 1.f);
+    const int32_t note_lo = 127 - int32_t(view.scroll_y + areay / size + 1.f);
+    uint32_t first = 0, last = 0;
+    pat.note_range(beat0, beat1, first, last);
+    for (uint32_t i = first; i < last; ++i) {
+      const auto &note = pat.notes[i];
+      if (note.note < note_lo || note.note > note_hi) {
+        continue;
+      }
+      const float x = (note.start * PATTERN_COLS_PER_BEAT - view.scroll_x) * size;
+      const float y = (float(127 - (note.note)) - view.scroll_y) * size;
 
-    uint32_t rgb = (note.instrument == _gui_instrument) ? 0xffffffff : 0xffff8866;
+      uint32_t rgb = (note.instrument == _gui_instrument) ? 0xffffffff : 0xffff8866;
 
-    Draw->AddCircle(ImVec2{ minx + x, miny + y }, size / 2.f, rgb);
+      Draw->AddCircle(ImVec2{ minx + x, miny + y }, size / 2.f, rgb);
+    }
   }
 
-  if (IO.MouseClicked[0] || IO.MouseClicked[1]) {
-    const int32_t dx = int32_t((IO.MousePos.x - minx + (size / 2)) / size);
-    const int32_t dy = int32_t((IO.MousePos.y - miny + (size / 2)) / size);
+  Draw->PopClipRect();
 
+  if (hovered && (IO.MouseClicked[0] || IO.MouseClicked[1])) {
     Tracker::note_t n;
     n.instrument = _gui_instrument;
-    n.start = float(dx) / 4.f;
-    n.note = 127 - dy;
+    n.start = float(ix) / float(PATTERN_COLS_PER_BEAT);
+    n.note = 127 - iy;
 
-    if (n.start >= 0.f && n.start < 16.f && n.note > 0 && n.note <= 127) {
-      std::lock_guard<std::mutex>(_player->mutex());
-      if (IO.MouseClicked[0]) {
+    if (n.start >= 0.f && n.start < float(Tracker::BEATS_IN_PATTERN) && iy >= 0 && iy < 127) {
+      std::lock_guard<std::mutex> guard{ _player->mutex() };
+      if (IO.MouseClicked[0] && under < 0) {
         pat.note_insert(n);
+        // audition the new note
+        _live->play_note(n);
       }
-      if (IO.MouseClicked[1]) {
-        pat.note_remove(n);
+      if (IO.MouseClicked[1] && under >= 0) {
+        const Tracker::note_t old = pat.notes[under];
+        pat.note_remove(old);
       }
     }
   }
@@ -298,11 +754,62 @@ void visit_pattern() {
   ImGui::End();
 }
 
+// replace the song being edited with one loaded from a song file
+bool load_song(const char *path) {
+  std::unique_ptr<Tracker::song_t> song{ new Tracker::song_t };
+  const auto loader = [](const std::string &name) {
+    return _pool.get(name);
+  };
+  if (!Tracker::song_load(path, *song, loader)) {
+    return false;
+  }
+  _player->stop();
+  _live->stop();
+  _render_ahead->flush();
+  // the player keeps a reference to _song so copy the new song into it
+  std::lock_guard<std::mutex> guard{ _player->mutex() };
+  _song->bpm = song->bpm;
+  for (size_t i = 0; i < _song->patterns.size(); ++i) {
+    // move the revision past the pattern being replaced so views keyed
+    // on it see a change
+    const uint32_t revision = _song->patterns[i].revision + 1;
+    _song->patterns[i] = song->patterns[i];
+    _song->patterns[i].revision = revision;
+  }
+  _song->orders_head = song->orders_head;
+  _song->orders = song->orders;
+  for (uint32_t i = 0; i < Tracker::MAX_INSTUMENTS; ++i) {
+    auto &dst = _song->instruments[i];
+    auto &src = song->instruments[i];
+    dst.root = src.root;
+    dst.fine = src.fine;
+    dst.sample_start = src.sample_start;
+    dst.sample_end = src.sample_end;
+    dst.interp = src.interp;
+    dst.loop = src.loop;
+    _sample_bin.retire({ _player.get(), _live.get() }, dst.set_sample(src.set_sample(nullptr)));
+    // the song keeps its own tuning and markers
+    _ins_analysed[i] = false;
+  }
+  return true;
+}
+
 void visit_song() {
+  TRACE_ZONE("visit_song");
   if (!_song) {
     return;
   }
   ImGui::Begin("Song");
+  {
+    ImGui::InputText("File", _gui_song_path, sizeof(_gui_song_path));
+    if (ImGui::Button("Save")) {
+      Tracker::song_save(_gui_song_path, *_song);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Load")) {
+      load_song(_gui_song_path);
+    }
+  }
   // do BPM stuff
   {
     int bpm = _song->bpm;
@@ -319,22 +826,186 @@ void visit_song() {
 }
 
 void visit_player() {
+  TRACE_ZONE("visit_player");
   if (!_player) {
     return;
   }
   ImGui::Begin("Player");
   if (ImGui::Button("Play")) {
     _player->play();
+    // drop audio rendered ahead from before the change
+    _render_ahead->flush();
   }
   if (ImGui::Button("Stop")) {
     _player->stop();
+    _render_ahead->flush();
+  }
+  {
+    bool ahead = _render_ahead->running();
+    if (ImGui::Checkbox("Render Ahead", &ahead)) {
+      if (ahead) {
+        _render_ahead->start();
+      }
+      else {
+        _render_ahead->stop();
+      }
+    }
+    int ms = int(_render_ahead->lookahead() * 1000 / _engine_rate);
+    if (ImGui::SliderInt("Lookahead ms", &ms, 10, 500)) {
+      _render_ahead->set_lookahead(uint32_t(ms) * _engine_rate / 1000);
+    }
+    ImGui::Text("Underruns %d", int(_render_ahead->underruns()));
+  }
+  // the button is only shown in builds with TRACKER_TRACE
+  if (Tracker::trace_enabled() && ImGui::Button("Save Trace")) {
+    if (!Tracker::trace_save("trace.json")) {
+      fprintf(stderr, "unable to save trace.json\n");
+    }
+  }
+  ImGui::End();
+}
+
+enum {
+  // samples per spectrum transform
+  SPECTRUM_SIZE = 4096,
+  // log spaced bands drawn in the spectrum
+  SPECTRUM_BANDS = 128,
+};
+
+// output window state, everything here belongs to the ui thread
+struct output_view_t {
+
+  output_view_t()
+    : cursor(0)
+    , fft(SPECTRUM_SIZE)
+    , history(SPECTRUM_SIZE, 0)
+    , bins(SPECTRUM_SIZE)
+    , window(SPECTRUM_SIZE)
+    , bands(SPECTRUM_BANDS, -120.f)
+    , peak_db(-120.f)
+    , rms_db(-120.f)
+    , clip(false)
+  {
+    // hann window scaled so a full scale sine reads 0 db
+    float sum = 0.f;
+    for (uint32_t i = 0; i < SPECTRUM_SIZE; ++i) {
+      window[i] = 0.5f - 0.5f * cosf(2.f * 3.14159265f * float(i) / float(SPECTRUM_SIZE));
+      sum += window[i];
+    }
+    for (float &w : window) {
+      w *= 2.f / (sum * 32768.f);
+    }
+  }
+
+  // position of the ui in the tap
+  uint64_t cursor;
+  Tracker::fft_t fft;
+  // the most recent SPECTRUM_SIZE output samples
+  std::vector<int16_t> history;
+  std::vector<std::complex<float>> bins;
+  std::vector<float> window;
+  // displayed levels, these fall back slowly so peaks can be read
+  std::vector<float> bands;
+  float peak_db;
+  float rms_db;
+  // latched when a sample reaches full scale
+  bool clip;
+};
+
+static output_view_t _output_view;
+
+// read the new output from the tap and update the meters and spectrum
+void visit_output() {
+  TRACE_ZONE("visit_output");
+  auto &view = _output_view;
+  const float dt = ImGui::GetIO().DeltaTime;
+  const float fall = 30.f * dt;
+
+  int32_t peak = 0;
+  double sum = 0.0;
+  uint64_t count = 0;
+  std::array<int16_t, 4096> temp;
+  while (const uint32_t n = _tap.read(view.cursor, temp.data(), uint32_t(temp.size()))) {
+    for (uint32_t i = 0; i < n; ++i) {
+      const int32_t v = temp[i];
+      peak = std::max(peak, std::abs(v));
+      sum += double(v) * double(v);
+    }
+    count += n;
+    // keep the newest samples for the spectrum
+    if (n >= SPECTRUM_SIZE) {
+      std::copy(temp.begin() + (n - SPECTRUM_SIZE), temp.begin() + n, view.history.begin());
+    }
+    else {
+      std::move(view.history.begin() + n, view.history.end(), view.history.begin());
+      std::copy(temp.begin(), temp.begin() + n, view.history.end() - n);
+    }
+  }
+  const auto to_db = [](double v) {
+    return (v > 0.0) ? float(20.0 * log10(v / 32768.0)) : -120.f;
+  };
+  view.clip |= (peak >= 32767);
+  view.peak_db = std::max(to_db(peak), view.peak_db - fall);
+  view.rms_db = count ? to_db(sqrt(sum / double(count))) : view.rms_db - fall;
+
+  if (count) {
+    for (uint32_t i = 0; i < SPECTRUM_SIZE; ++i) {
+      view.bins[i] = std::complex<float>(float(view.history[i]) * view.window[i], 0.f);
+    }
+    view.fft.forward(view.bins.data());
+    // take the loudest bin in each log spaced band from 20hz to nyquist
+    const float nyquist = float(_output_rate) / 2.f;
+    const float hz_per_bin = float(_output_rate) / float(SPECTRUM_SIZE);
+    for (uint32_t b = 0; b < SPECTRUM_BANDS; ++b) {
+      const float f0 = 20.f * powf(nyquist / 20.f, float(b) / SPECTRUM_BANDS);
+      const float f1 = 20.f * powf(nyquist / 20.f, float(b + 1) / SPECTRUM_BANDS);
+      const uint32_t i0 = std::max(1u, uint32_t(f0 / hz_per_bin));
+      const uint32_t i1 = std::min(uint32_t(SPECTRUM_SIZE / 2), std::max(i0 + 1, uint32_t(f1 / hz_per_bin)));
+      float mag = 0.f;
+      for (uint32_t i = i0; i < i1; ++i) {
+        mag = std::max(mag, std::abs(view.bins[i]));
+      }
+      const float db = (mag > 0.f) ? 20.f * log10f(mag) : -120.f;
+      view.bands[b] = std::max(db, view.bands[b] - fall);
+    }
+  }
+  else {
+    for (float &b : view.bands) {
+      b -= fall;
+    }
+  }
+
+  ImGui::Begin("Output");
+  const float width = std::max(ImGui::GetContentRegionAvail().x, 64.f);
+  ImGui::PlotLines("##Spectrum", view.bands.data(), SPECTRUM_BANDS, 0, "spectrum",
+    -100.f, 0.f, ImVec2{ width, 120.f });
+  // meters show the last 60db
+  const auto meter = [](float db) {
+    return std::min(std::max((db + 60.f) / 60.f, 0.f), 1.f);
+  };
+  char label[32];
+  snprintf(label, sizeof(label), "Peak %.1f dB", view.peak_db);
+  ImGui::ProgressBar(meter(view.peak_db), ImVec2{ width, 0.f }, label);
+  snprintf(label, sizeof(label), "RMS %.1f dB", view.rms_db);
+  ImGui::ProgressBar(meter(view.rms_db), ImVec2{ width, 0.f }, label);
+  if (view.clip) {
+    ImGui::TextColored(ImVec4{ 1.f, .2f, .2f, 1.f }, "CLIP");
+    ImGui::SameLine();
+    if (ImGui::Button("Reset")) {
+      view.clip = false;
+    }
+  }
+  else {
+    ImGui::Text("No Clipping");
   }
   ImGui::End();
 }
 
 void tick() {
+  install_samples();
   visit_song();
   visit_player();
+  visit_output();
   visit_instrument();
   visit_pattern();
   visit_samples();
@@ -342,6 +1013,11 @@ void tick() {
 
 int main() {
   SDL_SetMainReady();
+  TRACE_THREAD("ui");
+  // back sample memory with huge pages, set before anything is loaded
+  if (const char *huge = getenv("TRACKER_HUGE_PAGES")) {
+    Tracker::sample_arena().set_huge_pages(atoi(huge) != 0);
+  }
   if (!app_init()) {
     return -1;
   }
@@ -361,7 +1037,17 @@ int main() {
     pat.note_insert(Tracker::note_t{ 4,  69,      0 });
 #endif
   }
-  _player.reset(new Tracker::player_t(*_song.get(), 44100));
+  if (const char *rate = getenv("TRACKER_RATE")) {
+    _engine_rate = uint32_t(atoi(rate));
+  }
+  if (!_resampler.init(_engine_rate, _output_rate)) {
+    fprintf(stderr, "unsupported engine rate %u, using %u\n", _engine_rate, _output_rate);
+    _engine_rate = _output_rate;
+    _resampler.init(_engine_rate, _output_rate);
+  }
+  _player.reset(new Tracker::player_t(*_song.get(), _engine_rate));
+  _live.reset(new Tracker::player_t(*_song.get(), _engine_rate));
+  _render_ahead.reset(new Tracker::render_ahead_t(*_player, 4096));
 
   audio_init();
 
@@ -0,0 +1,211 @@
+#include <cstdlib>
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "memory.h"
+
+
+namespace {
+
+enum {
+  // huge page size assumed when rounding huge page backed chunks
+  HUGE_PAGE = 2 << 20,
+};
+
+size_t round_up(size_t bytes, size_t align) {
+  return (bytes + align - 1) & ~(align - 1);
+}
+
+// round up to a size class, cache line multiples up to four cache lines
+// then four classes for each power of two
+size_t size_class(size_t bytes) {
+  bytes = std::max<size_t>(bytes, 1);
+  if (bytes <= 4 * Tracker::CACHE_LINE) {
+    return round_up(bytes, Tracker::CACHE_LINE);
+  }
+  size_t pow2 = 4 * Tracker::CACHE_LINE;
+  while (pow2 * 2 < bytes) {
+    pow2 *= 2;
+  }
+  return round_up(bytes, pow2 / 4);
+}
+
+}  // namespace
+
+namespace Tracker {
+
+void *aligned_malloc(size_t bytes, size_t align) {
+#if defined(_MSC_VER)
+  return _aligned_malloc(bytes ? bytes : 1, align);
+#else
+  void *ptr = nullptr;
+  if (posix_memalign(&ptr, align, bytes ? bytes : 1) != 0) {
+    return nullptr;
+  }
+  return ptr;
+#endif
+}
+
+void aligned_free(void *ptr) {
+#if defined(_MSC_VER)
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+arena_t::arena_t(size_t chunk_bytes, bool huge_pages)
+  : _chunk_bytes(round_up(std::max<size_t>(chunk_bytes, 64 << 10), CACHE_LINE))
+  , _huge_pages(huge_pages)
+  , _head(nullptr)
+  , _tail(nullptr)
+  , _reserved(0)
+  , _in_use(0)
+{
+}
+
+arena_t::~arena_t() {
+  for (const auto &c : _chunks) {
+    _unmap(c);
+  }
+  for (const auto &l : _large) {
+    _unmap(l.second);
+  }
+}
+
+void *arena_t::alloc(size_t bytes) {
+  const size_t size = size_class(bytes);
+  std::lock_guard<std::mutex> guard{ _mutex };
+  void *ptr = nullptr;
+  if (size > _chunk_bytes / 2) {
+    const chunk_t c = _map(size, _huge_pages);
+    if (!c.base) {
+      return nullptr;
+    }
+    ptr = c.base;
+    _large.emplace(ptr, c);
+    _reserved += c.size;
+  }
+  else {
+    auto &list = _free[size];
+    if (!list.empty()) {
+      ptr = list.back();
+      list.pop_back();
+    }
+    else {
+      if (size_t(_tail - _head) < size) {
+        // the rest of the current chunk is left unused
+        const chunk_t c = _map(_chunk_bytes, _huge_pages);
+        if (!c.base) {
+          return nullptr;
+        }
+        _chunks.push_back(c);
+        _reserved += c.size;
+        _head = c.base;
+        _tail = c.base + c.size;
+      }
+      ptr = _head;
+      _head += size;
+    }
+  }
+  _sizes.emplace(ptr, size);
+  _in_use += size;
+  return ptr;
+}
+
+void arena_t::free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard{ _mutex };
+  auto itt = _sizes.find(ptr);
+  if (itt == _sizes.end()) {
+    return;
+  }
+  const size_t size = itt->second;
+  _sizes.erase(itt);
+  _in_use -= size;
+  auto large = _large.find(ptr);
+  if (large != _large.end()) {
+    _reserved -= large->second.size;
+    _unmap(large->second);
+    _large.erase(large);
+    return;
+  }
+  _free[size].push_back(ptr);
+}
+
+void arena_t::set_huge_pages(bool enable) {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  _huge_pages = enable;
+}
+
+size_t arena_t::reserved() const {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  return _reserved;
+}
+
+size_t arena_t::in_use() const {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  return _in_use;
+}
+
+arena_t::chunk_t arena_t::_map(size_t bytes, bool huge) {
+  chunk_t c{ nullptr, bytes, false };
+#if defined(_WIN32)
+  // large pages need a privilege few users have so they are not tried
+  c.base = static_cast<uint8_t *>(
+    VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+  if (huge) {
+    c.size = round_up(bytes, HUGE_PAGE);
+#if defined(MAP_HUGETLB)
+    // explicit huge pages only exist if the system has reserved some
+    void *p = mmap(nullptr, c.size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      c.base = static_cast<uint8_t *>(p);
+      c.huge = true;
+      return c;
+    }
+#endif
+  }
+  void *p = mmap(nullptr, c.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return c;
+  }
+  c.base = static_cast<uint8_t *>(p);
+#if defined(MADV_HUGEPAGE)
+  if (huge) {
+    // otherwise ask for transparent huge pages
+    madvise(p, c.size, MADV_HUGEPAGE);
+  }
+#endif
+#endif
+  return c;
+}
+
+void arena_t::_unmap(const chunk_t &chunk) {
+#if defined(_WIN32)
+  VirtualFree(chunk.base, 0, MEM_RELEASE);
+#else
+  munmap(chunk.base, chunk.size);
+#endif
+}
+
+arena_t &sample_arena() {
+  // never destroyed as samples may outlive any other static
+  static arena_t *arena = new arena_t;
+  return *arena;
+}
+
+}  // namespace Tracker
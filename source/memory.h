@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Tracker {
+
+enum {
+  // alignment of sample data so simd loads never straddle a cache line
+  CACHE_LINE = 64,
+};
+
+// allocate bytes aligned to align, which must be a power of two
+// returns nullptr on failure
+void *aligned_malloc(size_t bytes, size_t align);
+
+void aligned_free(void *ptr);
+
+// deleter for std::unique_ptr holding aligned_malloc() memory
+struct aligned_delete_t {
+  void operator()(void *ptr) const {
+    aligned_free(ptr);
+  }
+};
+
+// cache line aligned allocations carved from large chunks of memory
+//
+// memory is taken from the system a chunk at a time, optionally backed by
+// huge pages, and handed out in size classes four to each power of two so
+// that no more than a quarter is lost to rounding. freed memory goes onto
+// a list for its class and is reused by the next allocation of that class
+// rather than returned, so swapping samples of similar sizes does not
+// fragment the heap. allocations larger than half a chunk get a mapping of
+// their own which is returned to the system when they are freed. safe to
+// use from any thread but it takes a lock, so not from the audio thread.
+struct arena_t {
+
+  explicit arena_t(size_t chunk_bytes = 16 << 20, bool huge_pages = false);
+  ~arena_t();
+
+  // returns nullptr on failure
+  void *alloc(size_t bytes);
+
+  // ptr must have come from alloc() of this arena or be nullptr
+  void free(void *ptr);
+
+  // back chunks taken from now on with huge pages where the system has them
+  void set_huge_pages(bool enable);
+
+  // bytes taken from the system and bytes currently allocated
+  size_t reserved() const;
+  size_t in_use() const;
+
+protected:
+  struct chunk_t {
+    uint8_t *base;
+    size_t size;
+    bool huge;
+  };
+
+  static chunk_t _map(size_t bytes, bool huge);
+  static void _unmap(const chunk_t &chunk);
+
+  mutable std::mutex _mutex;
+  const size_t _chunk_bytes;
+  bool _huge_pages;
+  std::vector<chunk_t> _chunks;
+  // unused end of the newest chunk
+  uint8_t *_head;
+  uint8_t *_tail;
+  // freed allocations by size class
+  std::unordered_map<size_t, std::vector<void *>> _free;
+  // size class of each live allocation
+  std::unordered_map<void *, size_t> _sizes;
+  // allocations with a mapping of their own
+  std::unordered_map<void *, chunk_t> _large;
+  size_t _reserved;
+  size_t _in_use;
+};
+
+// the arena sample data is allocated from, it lives until the program
+// exits so samples may safely be released by static destructors
+arena_t &sample_arena();
+
+// deleter for std::unique_ptr holding sample_arena() memory
+struct sample_delete_t {
+  void operator()(void *ptr) const {
+    sample_arena().free(ptr);
+  }
+};
+
+}  // namespace Tracker
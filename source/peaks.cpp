@@ -0,0 +1,93 @@
+#include <algorithm>
+
+#include "peaks.h"
+#include "tracker.h"
+
+
+namespace Tracker {
+
+void peaks_t::build(const sample_t &sample) {
+  levels.clear();
+  const uint32_t size = sample.size;
+  if (!sample.data || size == 0) {
+    return;
+  }
+  // finest level is taken from the samples directly
+  {
+    std::vector<bin_t> level((size + BASE_BIN - 1) / BASE_BIN);
+    for (uint32_t i = 0; i < level.size(); ++i) {
+      const uint32_t a = i * BASE_BIN;
+      const uint32_t b = std::min<uint32_t>(a + BASE_BIN, size);
+      const int16_t first = sample.frame(a);
+      bin_t bin = { first, first };
+      for (uint32_t j = a + 1; j < b; ++j) {
+        const int16_t v = sample.frame(j);
+        bin.min = std::min(bin.min, v);
+        bin.max = std::max(bin.max, v);
+      }
+      level[i] = bin;
+    }
+    levels.push_back(std::move(level));
+  }
+  // each coarser level merges pairs of bins from the level below
+  while (levels.back().size() > 1) {
+    const std::vector<bin_t> &src = levels.back();
+    std::vector<bin_t> level((src.size() + 1) / 2);
+    for (uint32_t i = 0; i < level.size(); ++i) {
+      const bin_t &a = src[i * 2];
+      const bin_t &b = src[std::min<size_t>(i * 2 + 1, src.size() - 1)];
+      level[i] = bin_t{ std::min(a.min, b.min), std::max(a.max, b.max) };
+    }
+    levels.push_back(std::move(level));
+  }
+}
+
+void peaks_t::query(const sample_t &sample, uint32_t start, uint32_t end,
+                    uint32_t count, bin_t *out) const {
+  end = std::min(end, sample.size);
+  if (count == 0) {
+    return;
+  }
+  if (!sample.data || levels.empty() || start >= end) {
+    std::fill(out, out + count, bin_t{ 0, 0 });
+    return;
+  }
+  const double spp = double(end - start) / double(count);
+  // pick the coarsest level whose bins are no wider than a pixel
+  uint32_t level = 0;
+  uint32_t width = BASE_BIN;
+  while (level + 1 < levels.size() && double(width * 2) <= spp) {
+    ++level;
+    width *= 2;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t a = start + uint32_t(spp * i);
+    const uint32_t b = std::max(a + 1, std::min(end, start + uint32_t(spp * (i + 1))));
+    if (a >= end) {
+      out[i] = bin_t{ 0, 0 };
+      continue;
+    }
+    const int16_t first = sample.frame(a);
+    bin_t bin = { first, first };
+    if (spp < BASE_BIN) {
+      // zoomed in enough that reading the samples is cheaper
+      for (uint32_t j = a + 1; j < b; ++j) {
+        const int16_t v = sample.frame(j);
+        bin.min = std::min(bin.min, v);
+        bin.max = std::max(bin.max, v);
+      }
+    }
+    else {
+      const std::vector<bin_t> &src = levels[level];
+      const uint32_t b0 = a / width;
+      const uint32_t b1 = std::min<uint32_t>(uint32_t(src.size()), (b + width - 1) / width);
+      for (uint32_t j = b0; j < b1; ++j) {
+        bin.min = std::min(bin.min, src[j].min);
+        bin.max = std::max(bin.max, src[j].max);
+      }
+    }
+    out[i] = bin;
+  }
+}
+
+}  // namespace Tracker
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+
+namespace Tracker {
+
+struct sample_t;
+
+// multi-resolution min/max summary of a sample, so that a waveform can be
+// drawn at any zoom level by touching a number of bins proportional to the
+// number of pixels rather than the number of samples
+struct peaks_t {
+
+  enum {
+    // samples summarised by each bin in the finest level
+    BASE_BIN = 16,
+  };
+
+  struct bin_t {
+    int16_t min;
+    int16_t max;
+  };
+
+  // build all levels from the sample data
+  void build(const sample_t &sample);
+
+  // summarise the frames in [start, end) into count bins
+  // sample must be the one the pyramid was built from
+  void query(const sample_t &sample, uint32_t start, uint32_t end,
+             uint32_t count, bin_t *out) const;
+
+  void clear() {
+    levels.clear();
+  }
+
+  // levels[0] has one bin per BASE_BIN samples and each level after that
+  // halves the number of bins
+  std::vector<std::vector<bin_t>> levels;
+};
+
+}  // namespace Tracker
@@ -0,0 +1,124 @@
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "render_ahead.h"
+#include "trace.h"
+
+
+namespace {
+
+// ask the os to schedule the render thread ahead of normal work, this is
+// allowed to fail as it often needs extra privileges
+void raise_priority() {
+#if defined(_WIN32)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+  sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+  pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+}  // namespace
+
+namespace Tracker {
+
+render_ahead_t::render_ahead_t(player_t &player, uint32_t lookahead_frames)
+  : _player(player)
+  , _ring(MAX_BLOCKS)
+  , _running(false)
+  , _lookahead(1)
+  , _generation(0)
+  , _underruns(0)
+  , _offset(0)
+{
+  set_lookahead(lookahead_frames);
+}
+
+render_ahead_t::~render_ahead_t() {
+  stop();
+}
+
+void render_ahead_t::start() {
+  if (_running.load()) {
+    return;
+  }
+  // anything left from a previous run is stale
+  flush();
+  _running = true;
+  _thread = std::thread([this]() { _thread_main(); });
+}
+
+void render_ahead_t::stop() {
+  if (!_running.load()) {
+    return;
+  }
+  _running = false;
+  _thread.join();
+}
+
+void render_ahead_t::set_lookahead(uint32_t frames) {
+  const uint32_t blocks = (frames + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+  // the ring must always have a free block for the producer to fill
+  _lookahead = std::min<uint32_t>(std::max<uint32_t>(blocks, 1), _ring.capacity() - 1);
+}
+
+void render_ahead_t::flush() {
+  ++_generation;
+}
+
+void render_ahead_t::_thread_main() {
+  TRACE_THREAD("render ahead");
+  raise_priority();
+  while (_running.load()) {
+    block_t *block = (_ring.size() < _lookahead.load()) ? _ring.back() : nullptr;
+    if (!block) {
+      // far enough ahead, wait for the device to catch up
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    // a flush while rendering leaves this block with an old generation
+    block->generation = _generation.load();
+    memset(block->frames, 0, sizeof(block->frames));
+    _player.render(block->frames, BLOCK_FRAMES);
+    _ring.push();
+  }
+}
+
+uint32_t render_ahead_t::read(int16_t *out, uint32_t frames) {
+  const uint32_t generation = _generation.load();
+  uint32_t done = 0;
+  while (done < frames) {
+    block_t *block = _ring.front();
+    if (!block) {
+      ++_underruns;
+      break;
+    }
+    if (block->generation != generation) {
+      _ring.pop();
+      _offset = 0;
+      continue;
+    }
+    const uint32_t count = std::min<uint32_t>(BLOCK_FRAMES - _offset, frames - done);
+    memcpy(out + done, block->frames + _offset, count * sizeof(int16_t));
+    done += count;
+    _offset += count;
+    if (_offset == BLOCK_FRAMES) {
+      _ring.pop();
+      _offset = 0;
+    }
+  }
+  return done;
+}
+
+}  // namespace Tracker
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <thread>
+
+#include "tracker.h"
+#include "ring.h"
+
+
+namespace Tracker {
+
+// renders a player ahead of the audio device on a dedicated thread
+//
+// finished blocks are passed to the audio callback through a lock free
+// ring so the callback only copies audio and never waits on the render.
+// blocks are tagged with the generation they were rendered in, and flush()
+// starts a new generation so that audio rendered before a transport change
+// is dropped rather than played.
+struct render_ahead_t {
+
+  enum {
+    // frames in one ring block
+    BLOCK_FRAMES = 256,
+    // upper limit on the lookahead
+    MAX_BLOCKS = 512,
+  };
+
+  render_ahead_t(player_t &player, uint32_t lookahead_frames);
+  ~render_ahead_t();
+
+  // start or stop the render thread
+  void start();
+  void stop();
+
+  bool running() const {
+    return _running.load();
+  }
+
+  // frames rendered ahead of the audio device, rounded up to whole blocks
+  void set_lookahead(uint32_t frames);
+
+  uint32_t lookahead() const {
+    return _lookahead.load() * BLOCK_FRAMES;
+  }
+
+  // drop everything rendered so far, call after changing the transport
+  void flush();
+
+  // audio thread: copy up to frames of mono audio into out, returning the
+  // number copied. frames not copied were not ready and count as an underrun
+  uint32_t read(int16_t *out, uint32_t frames);
+
+  // number of reads that could not be completed
+  uint32_t underruns() const {
+    return _underruns.load();
+  }
+
+protected:
+  struct block_t {
+    uint32_t generation;
+    int16_t frames[BLOCK_FRAMES];
+  };
+
+  void _thread_main();
+
+  player_t &_player;
+  spsc_ring_t<block_t> _ring;
+  std::thread _thread;
+  std::atomic<bool> _running;
+  // blocks to keep rendered ahead
+  std::atomic<uint32_t> _lookahead;
+  std::atomic<uint32_t> _generation;
+  std::atomic<uint32_t> _underruns;
+  // frames of the front block already read, owned by the audio thread
+  uint32_t _offset;
+};
+
+}  // namespace Tracker
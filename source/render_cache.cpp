@@ -0,0 +1,329 @@
+#include <algorithm>
+
+#include "render_cache.h"
+
+
+namespace {
+
+template <typename type_t>
+void put(std::string &key, const type_t &v) {
+  key.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+template <typename voices_t>
+uint32_t busy(const voices_t &voices) {
+  uint32_t count = 0;
+  for (const auto &v : voices) {
+    count += v.step ? 1 : 0;
+  }
+  return count;
+}
+
+}  // namespace
+
+namespace Tracker {
+
+render_cache_t::render_cache_t(size_t budget)
+  : _budget(budget)
+  , _bytes(0)
+  , _tick(0)
+  , _song(nullptr)
+  , _playing(false)
+  , _order(0)
+  , _length(0)
+  , _offset(0)
+  , _hits(0)
+  , _misses(0)
+  , _tails(0)
+  , _rendered(0)
+{
+}
+
+void render_cache_t::start(const song_t &song, uint32_t sample_rate) {
+  _song = &song;
+  _player.reset(new player_t(song, sample_rate));
+  _playing = true;
+  _order = 0;
+  _voices = voices_t();
+  _hits = 0;
+  _misses = 0;
+  _tails = 0;
+  _rendered = 0;
+  _begin_pattern();
+}
+
+void render_cache_t::stop() {
+  _playing = false;
+  _entry.reset();
+  _tail.reset();
+}
+
+void render_cache_t::clear() {
+  _entries.clear();
+  _bytes = 0;
+}
+
+void render_cache_t::set_budget(size_t budget) {
+  _budget = budget;
+  _trim();
+}
+
+void render_cache_t::_make_key(const pattern_t &pattern, const voices_t &voices, std::string &key,
+                               std::vector<std::shared_ptr<const sample_t>> &samples) const {
+  key.clear();
+  samples.clear();
+  const uint8_t tail = busy(voices) ? 1 : 0;
+  put(key, tail);
+  put(key, _player->_sample_rate);
+  put(key, _song->bpm);
+  // the notes of the pattern
+  uint32_t used = 0;
+  put(key, pattern.notes_head);
+  for (uint32_t i = 0; i < pattern.notes_head; ++i) {
+    const note_t &n = pattern.notes[i];
+    put(key, n.start);
+    put(key, n.note);
+    put(key, n.instrument);
+    used |= 1u << n.instrument;
+  }
+  // the voices coming in from the pattern before, a voice is free when
+  // its step is zero and then nothing else about it matters
+  for (const auto &v : voices) {
+    if (!tail) {
+      break;
+    }
+    put(key, v.step);
+    if (v.step) {
+      put(key, v.instrument);
+      put(key, v.phase);
+      put(key, v.loop);
+      put(key, v.sample);
+      put(key, v.kernel);
+      used |= 1u << v.instrument;
+    }
+  }
+  // every instrument either of those can play
+  for (uint32_t i = 0; i < MAX_INSTUMENTS; ++i) {
+    if (!(used & (1u << i))) {
+      continue;
+    }
+    const instrument_t &inst = _song->instruments[i];
+    put(key, i);
+    put(key, inst.root);
+    put(key, inst.fine);
+    put(key, inst.sample_start);
+    put(key, inst.sample_end);
+    put(key, inst.interp);
+    put(key, inst.loop);
+    put(key, inst.sample());
+    samples.push_back(inst.sample_ref());
+  }
+}
+
+void render_cache_t::_render_pattern(const pattern_t &pattern, const voices_t &voices, entry_t &entry) {
+  // play one pass of the pattern from the given voices
+  player_t &p = *_player;
+  p._note_stack = voices;
+  p._pattern = &pattern;
+  p._playback_pos = 0;
+  p._note = nullptr;
+  p._song_mode = false;
+  p._song_end = false;
+  p._playing = true;
+  // room for the whole pattern so the player is only ever stopped at a
+  // note, which makes the pattern timing the same as one long render()
+  const double seconds = double(BEATS_IN_PATTERN) * 60.0 / double(_song->bpm);
+  const size_t limit = size_t(seconds * double(p._sample_rate)) + 1;
+  entry.audio.assign(limit, 0);
+  entry.triggers.clear();
+  size_t done = 0;
+  for (;;) {
+    const bool last = (p._next_note(p._note) == nullptr);
+    const note_t *note = p._note;
+    done += p._render_samples(entry.audio.data() + done, uint32_t(limit - done));
+    if (p._note && p._note != note) {
+      // a note was started after the frames just rendered
+      entry.triggers.push_back(trigger_t{ uint32_t(done), p._note->instrument, uint8_t(busy(p._note_stack)) });
+    }
+    // _on_pattern_end() puts the position back to the start
+    if ((last && p._playback_pos == 0.f) || done == limit) {
+      break;
+    }
+  }
+  // at most a frame short of the limit so it is not worth a copy to shrink
+  entry.audio.resize(done);
+  entry.voices = p._note_stack;
+  _rendered += done;
+}
+
+bool render_cache_t::_render_tail(const entry_t &pattern, entry_t &tail) {
+  // the incoming voices are rendered between the same notes as the pattern
+  // was, so each voice is split into the same runs as by one player
+  voices_t voices = _voices;
+  const size_t length = pattern.audio.size();
+  _scratch.assign(length, 0);
+  size_t pos = 0;
+  const auto ring = [this, &voices, &pos](size_t end) {
+    for (auto &v : voices) {
+      if (v.step) {
+        v._render_samples(*_player, _scratch.data() + pos, uint32_t(end - pos));
+      }
+    }
+    pos = end;
+  };
+  for (const trigger_t &t : pattern.triggers) {
+    if (!busy(voices)) {
+      break;
+    }
+    ring(t.offset);
+    // the note cuts a looping voice of its instrument as _start_note() does
+    for (auto &v : voices) {
+      if (v.step && v.loop && v.instrument == t.instrument) {
+        v.step = 0;
+      }
+    }
+    // with the tail holding voices the note may have found none free
+    if (t.busy + busy(voices) > MAX_NOTES_PLAYING) {
+      return false;
+    }
+  }
+  if (busy(voices)) {
+    ring(length);
+  }
+  // the rest of the span is silent
+  tail.audio.assign(_scratch.begin(), _scratch.begin() + pos);
+  _rendered += pos;
+  // the voices still sounding go on into the next pattern with the
+  // pattern's own, where they are a tail again
+  tail.voices = pattern.voices;
+  for (const auto &v : voices) {
+    if (!v.step) {
+      continue;
+    }
+    auto slot = std::find_if(tail.voices.begin(), tail.voices.end(),
+      [](const playing_note_t &n) { return n.step == 0; });
+    if (slot == tail.voices.end()) {
+      return false;
+    }
+    *slot = v;
+  }
+  return true;
+}
+
+void render_cache_t::_begin_pattern() {
+  _offset = 0;
+  _entry.reset();
+  _tail.reset();
+  if (_order >= _song->orders_head) {
+    // the order list is done, let the voices ring out as play_song() does
+    player_t &p = *_player;
+    p._note_stack = _voices;
+    p._song_end = true;
+    p._playing = true;
+    return;
+  }
+  const pattern_t &pattern = _song->patterns[_song->orders[_order]];
+  std::string key;
+  std::vector<std::shared_ptr<const sample_t>> samples;
+  _make_key(pattern, voices_t(), key, samples);
+  auto itt = _entries.find(key);
+  if (itt != _entries.end()) {
+    ++_hits;
+  }
+  else {
+    ++_misses;
+    auto entry = std::make_shared<entry_t>();
+    entry->samples = std::move(samples);
+    _render_pattern(pattern, voices_t(), *entry);
+    _bytes += entry->audio.size() * sizeof(int16_t);
+    itt = _entries.emplace(std::move(key), std::move(entry)).first;
+  }
+  itt->second->used = ++_tick;
+  _entry = itt->second;
+  _length = _entry->audio.size();
+
+  if (busy(_voices)) {
+    _make_key(pattern, _voices, key, samples);
+    itt = _entries.find(key);
+    if (itt == _entries.end()) {
+      auto tail = std::make_shared<entry_t>();
+      tail->samples = std::move(samples);
+      if (_render_tail(*_entry, *tail)) {
+        ++_tails;
+      }
+      else {
+        // render the pattern whole, the pattern entry stays for when it
+        // is reached with other voices
+        ++_misses;
+        tail->whole = true;
+        _render_pattern(pattern, _voices, *tail);
+        tail->triggers.clear();
+      }
+      _bytes += tail->audio.size() * sizeof(int16_t);
+      itt = _entries.emplace(std::move(key), std::move(tail)).first;
+    }
+    itt->second->used = ++_tick;
+    _tail = itt->second;
+    if (_tail->whole) {
+      _entry.reset();
+      _length = _tail->audio.size();
+    }
+  }
+  _trim();
+}
+
+void render_cache_t::render(int16_t *out, uint32_t frames) {
+  while (_playing && frames) {
+    if (!_entry && !_tail) {
+      // only tails remain
+      _player->_render_samples(out, frames);
+      _playing = _player->_playing;
+      return;
+    }
+    const uint32_t count = uint32_t(std::min<size_t>(frames, _length - _offset));
+    for (const entry_t *e : { _entry.get(), _tail.get() }) {
+      if (!e || _offset >= e->audio.size()) {
+        continue;
+      }
+      // a tail stops once its voices have
+      const int16_t *audio = e->audio.data() + _offset;
+      const uint32_t n = uint32_t(std::min<size_t>(count, e->audio.size() - _offset));
+      for (uint32_t i = 0; i < n; ++i) {
+        out[i] = int16_t(out[i] + audio[i]);
+      }
+    }
+    out += count;
+    frames -= count;
+    _offset += count;
+    if (_offset == _length) {
+      // carry the voices still sounding into the next pattern
+      _voices = _tail ? _tail->voices : _entry->voices;
+      ++_order;
+      _begin_pattern();
+    }
+  }
+}
+
+void render_cache_t::_trim() {
+  if (_budget == 0) {
+    return;
+  }
+  while (_bytes > _budget && _entries.size() > 1) {
+    auto oldest = _entries.end();
+    for (auto itt = _entries.begin(); itt != _entries.end(); ++itt) {
+      if (itt->second == _entry || itt->second == _tail) {
+        continue;
+      }
+      if (oldest == _entries.end() || itt->second->used < oldest->second->used) {
+        oldest = itt;
+      }
+    }
+    if (oldest == _entries.end()) {
+      return;
+    }
+    _bytes -= oldest->second->audio.size() * sizeof(int16_t);
+    _entries.erase(oldest);
+  }
+}
+
+}  // namespace Tracker
@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tracker.h"
+
+
+namespace Tracker {
+
+// renders a song one pattern at a time keeping the audio of each pattern,
+// so that playing the song again after an edit only renders the patterns
+// that changed
+//
+// a pattern's own notes are rendered from silence and keyed by those notes,
+// the settings and samples of the instruments they use, the bpm and the
+// sample rate, so a pattern is rendered once however it is reached. the
+// voices left sounding by the pattern before it are rendered apart as a
+// tail over the same span, cut where the pattern's notes cut them, and
+// mixed in. voices mix by wrapping addition so the sum is exactly what one
+// player gives. tails are kept too, keyed by the pattern and the incoming
+// voices, so after an edit the patterns that follow only render the tails
+// that changed. when a tail would have taken the voice a pattern note
+// needed the pattern is rendered whole with its incoming voices instead.
+//
+// each pattern is rendered in one pass, so the output is that of a single
+// player_t::render() call over the whole song. the player's timing depends
+// a little on how it is split into blocks, so it may differ very slightly
+// from rendering the song block by block.
+//
+// samples used by cached patterns are held until they are evicted, so the
+// cache must be used from the thread that calls instrument_t::set_sample().
+struct render_cache_t {
+
+  explicit render_cache_t(size_t budget = 64 << 20);
+
+  // play the song order list from the start
+  void start(const song_t &song, uint32_t sample_rate);
+  void stop();
+
+  // true while the song is playing or notes are still ringing out
+  bool playing() const {
+    return _playing;
+  }
+
+  // mix frames of audio into out
+  void render(int16_t *out, uint32_t frames);
+
+  // drop every cached pattern
+  void clear();
+
+  // the least recently used patterns are evicted once the cached audio
+  // takes more than budget bytes
+  void set_budget(size_t budget);
+
+  size_t budget() const {
+    return _budget;
+  }
+
+  // number of cached patterns and the bytes of audio they hold
+  size_t size() const {
+    return _entries.size();
+  }
+
+  size_t bytes() const {
+    return _bytes;
+  }
+
+  // patterns taken from the cache and patterns rendered since start()
+  uint32_t hits() const {
+    return _hits;
+  }
+
+  uint32_t misses() const {
+    return _misses;
+  }
+
+  // incoming tails rendered since start()
+  uint32_t tails() const {
+    return _tails;
+  }
+
+  // frames of patterns and tails rendered rather than taken from the cache
+  // since start()
+  uint64_t rendered() const {
+    return _rendered;
+  }
+
+protected:
+  typedef std::array<playing_note_t, MAX_NOTES_PLAYING> voices_t;
+
+  // a note started by a pattern and the voices busy just after it
+  struct trigger_t {
+    uint32_t offset;
+    uint8_t instrument;
+    uint8_t busy;
+  };
+
+  struct entry_t {
+
+    entry_t()
+      : whole(false)
+      , used(0)
+    {
+    }
+
+    std::vector<int16_t> audio;
+    // voices still sounding when the pattern ended, for a tail those of
+    // the pattern and the tail together
+    voices_t voices;
+    // notes started by a pattern rendered from silence
+    std::vector<trigger_t> triggers;
+    // true if a tail entry holds the pattern rendered whole with its
+    // incoming voices rather than the tail alone
+    bool whole;
+    // samples the key refers to by address, held so no other sample can
+    // take their place while the entry exists
+    std::vector<std::shared_ptr<const sample_t>> samples;
+    uint64_t used;
+  };
+
+  // build the key for a pattern at the current order, with the voices
+  // coming into it for a tail
+  void _make_key(const pattern_t &pattern, const voices_t &voices, std::string &key,
+                 std::vector<std::shared_ptr<const sample_t>> &samples) const;
+  // render one pass of a pattern from a voice state into an entry
+  void _render_pattern(const pattern_t &pattern, const voices_t &voices, entry_t &entry);
+  // render the current incoming voices over a pattern, returning false if
+  // they would have changed which of its notes found a voice
+  bool _render_tail(const entry_t &pattern, entry_t &tail);
+  // find or render the pattern at the current order, or set up the player
+  // to ring out the tails once the order list is done
+  void _begin_pattern();
+  void _trim();
+
+  size_t _budget;
+  size_t _bytes;
+  uint64_t _tick;
+  std::unordered_map<std::string, std::shared_ptr<entry_t>> _entries;
+  // a tail is rendered here over the whole pattern then copied to its
+  // entry up to where its voices stopped
+  std::vector<int16_t> _scratch;
+
+  const song_t *_song;
+  std::unique_ptr<player_t> _player;
+  bool _playing;
+  // order list position, orders_head once only the tails remain
+  uint32_t _order;
+  // voices sounding at the start of the current pattern
+  voices_t _voices;
+  // the pattern being played and the tail mixed over it, either may be
+  // empty, and the length and next frame of the pattern
+  std::shared_ptr<const entry_t> _entry;
+  std::shared_ptr<const entry_t> _tail;
+  size_t _length;
+  size_t _offset;
+  uint32_t _hits;
+  uint32_t _misses;
+  uint32_t _tails;
+  uint64_t _rendered;
+};
+
+}  // namespace Tracker
@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "resampler.h"
+
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// fractional bits of the filter coefficients
+const int COEF_BITS = 14;
+
+// kaiser window shape, higher trades a wider transition for less ripple
+const double KAISER_BETA = 8.0;
+
+uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b) {
+    const uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// zeroth order modified bessel function of the first kind
+double bessel_i0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 32; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+}  // namespace
+
+namespace Tracker {
+
+resampler_t::resampler_t()
+  : _ops(&dsp())
+  , _in_rate(0)
+  , _out_rate(0)
+  , _up(1)
+  , _down(1)
+  , _fill(0)
+  , _pos(0)
+  , _phase(0)
+{
+}
+
+bool resampler_t::init(uint32_t in_rate, uint32_t out_rate, const dsp_t &ops) {
+  if (in_rate == 0 || out_rate == 0) {
+    return false;
+  }
+  const uint32_t g = gcd(in_rate, out_rate);
+  const uint32_t up = out_rate / g;
+  const uint32_t down = in_rate / g;
+  if (up > MAX_PHASES || down > up * MAX_DECIMATION) {
+    return false;
+  }
+  _ops = &ops;
+  _in_rate = in_rate;
+  _out_rate = out_rate;
+  _up = up;
+  _down = down;
+  _coefs.clear();
+  reset();
+  if (passthrough()) {
+    return true;
+  }
+
+  // prototype filter at the upsampled rate, cut off below the lower of the
+  // two nyquist rates by half the transition width of the window
+  const uint32_t length = up * TAPS;
+  const double centre = double(length - 1) / 2.0;
+  const double atten = KAISER_BETA / 0.1102 + 8.7;
+  const double transition = (atten - 7.95) / (14.36 * length);
+  const double cutoff = 0.5 / double(std::max(up, down)) - transition / 2.0;
+  std::vector<double> proto(length);
+  for (uint32_t t = 0; t < length; ++t) {
+    const double x = double(t) - centre;
+    const double sinc = (x == 0.0) ? 1.0 : sin(2.0 * PI * cutoff * x) / (2.0 * PI * cutoff * x);
+    const double r = x / (centre + 1.0);
+    const double window = bessel_i0(KAISER_BETA * sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(KAISER_BETA);
+    proto[t] = sinc * window;
+  }
+
+  // split into phases, coefficient k of phase p weights input frame i0 - k
+  // so it is stored reversed, and give every phase unity gain
+  _coefs.resize(size_t(up) * TAPS);
+  for (uint32_t p = 0; p < up; ++p) {
+    double sum = 0.0, abs_sum = 0.0;
+    for (uint32_t k = 0; k < TAPS; ++k) {
+      sum += proto[p + k * up];
+      abs_sum += fabs(proto[p + k * up]);
+    }
+    double gain = 1.0 / sum;
+    // dot_s16 needs any input times the filter to fit in 32 bits, q14 leaves
+    // room for a phase summing to 4 in magnitude which is never reached by
+    // a sane filter but is guarded against all the same
+    const double peak = abs_sum * fabs(gain);
+    if (peak > 3.99) {
+      gain *= 3.99 / peak;
+    }
+    for (uint32_t k = 0; k < TAPS; ++k) {
+      const double c = std::round(proto[p + k * up] * gain * double(1 << COEF_BITS));
+      _coefs[p * TAPS + (TAPS - 1 - k)] = int16_t(std::min(std::max(c, -32768.0), 32767.0));
+    }
+  }
+  return true;
+}
+
+void resampler_t::reset() {
+  // start with a history of silence
+  _input.assign(TAPS + CHUNK, 0);
+  _fill = TAPS - 1;
+  _pos = 0;
+  _phase = 0;
+}
+
+void resampler_t::pull(int16_t *out, uint32_t frames, const source_t &source) {
+  if (passthrough()) {
+    memset(out, 0, frames * sizeof(int16_t));
+    source(out, frames);
+    return;
+  }
+  uint32_t done = 0;
+  while (done < frames) {
+    if (_pos + TAPS > _fill) {
+      // move the frames still needed to the front and read some more
+      const uint32_t keep = _fill - _pos;
+      memmove(_input.data(), _input.data() + _pos, keep * sizeof(int16_t));
+      _pos = 0;
+      _fill = keep;
+      memset(_input.data() + _fill, 0, CHUNK * sizeof(int16_t));
+      source(_input.data() + _fill, CHUNK);
+      _fill += CHUNK;
+      continue;
+    }
+    const int32_t acc = _ops->dot_s16(_input.data() + _pos, _coefs.data() + _phase * TAPS, TAPS);
+    out[done++] = int16_t(std::min(std::max((acc + (1 << (COEF_BITS - 1))) >> COEF_BITS, -32768), 32767));
+    _phase += _down;
+    _pos += _phase / _up;
+    _phase %= _up;
+  }
+}
+
+}  // namespace Tracker
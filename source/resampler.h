@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "dsp.h"
+
+
+namespace Tracker {
+
+// converts a mono stream from one sample rate to another
+//
+// the ratio in_rate / out_rate is reduced to down / up and a windowed sinc
+// low pass filter is split into up phases of TAPS coefficients. each output
+// frame is then a single dot product of TAPS input frames with one phase,
+// which runs on the dsp kernels. the stream is pulled, the caller asks for
+// output frames and the resampler asks its source for input as needed.
+struct resampler_t {
+
+  enum {
+    // filter length in input frames, a multiple of 32 for dot_s16
+    TAPS = 64,
+    // upper limit on up, rate pairs needing more phases are rejected
+    MAX_PHASES = 1024,
+    // upper limit on down / up
+    MAX_DECIMATION = 16,
+    // input frames requested from the source at a time
+    CHUNK = 256,
+  };
+
+  // render frames of input into in, which has been cleared
+  typedef std::function<void(int16_t *in, uint32_t frames)> source_t;
+
+  resampler_t();
+
+  // prepare to convert between two rates, returning false if the rates are
+  // not supported. equal rates pass the source straight through.
+  bool init(uint32_t in_rate, uint32_t out_rate, const dsp_t &ops = dsp());
+
+  // forget the stream history
+  void reset();
+
+  // write frames of output, overwriting out
+  void pull(int16_t *out, uint32_t frames, const source_t &source);
+
+  bool passthrough() const {
+    return _up == _down;
+  }
+
+  // input frames read from the source that are yet to pass out of the
+  // filter, the output lags the input by this much
+  uint32_t buffered() const {
+    return passthrough() ? 0 : _fill - _pos;
+  }
+
+  uint32_t in_rate() const {
+    return _in_rate;
+  }
+
+  uint32_t out_rate() const {
+    return _out_rate;
+  }
+
+protected:
+  const dsp_t *_ops;
+  uint32_t _in_rate;
+  uint32_t _out_rate;
+  uint32_t _up;
+  uint32_t _down;
+  // up phases of TAPS coefficients in q14, each reversed for a dot product
+  std::vector<int16_t> _coefs;
+  // input history followed by frames not yet used
+  std::vector<int16_t> _input;
+  uint32_t _fill;
+  // first input frame under the filter for the next output
+  uint32_t _pos;
+  // filter phase for the next output
+  uint32_t _phase;
+};
+
+}  // namespace Tracker
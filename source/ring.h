@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+#include "memory.h"
+
+
+namespace Tracker {
+
+// lock free ring buffer for exactly one producer and one consumer thread
+//
+// elements are filled and read in place so nothing is copied through the
+// ring, the producer fills back() then calls push() and the consumer reads
+// front() then calls pop().
+template <typename type_t>
+struct spsc_ring_t {
+
+  // capacity is rounded up to a power of two
+  explicit spsc_ring_t(uint32_t capacity)
+    : _head(0)
+    , _tail(0)
+  {
+    _capacity = 1;
+    while (_capacity < capacity) {
+      _capacity <<= 1;
+    }
+    _items.reset(new type_t[_capacity]);
+  }
+
+  // producer: the element to fill next or nullptr if the ring is full
+  type_t *back() {
+    const uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= _capacity) {
+      return nullptr;
+    }
+    return &_items[head & (_capacity - 1)];
+  }
+
+  // producer: publish the element returned by back()
+  void push() {
+    _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // consumer: the oldest element or nullptr if the ring is empty
+  type_t *front() {
+    const uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &_items[tail & (_capacity - 1)];
+  }
+
+  // consumer: release the element returned by front()
+  void pop() {
+    _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // number of elements waiting, exact only when called from the producer
+  // or the consumer thread
+  uint32_t size() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+
+  uint32_t capacity() const {
+    return _capacity;
+  }
+
+protected:
+  // the producer and consumer indices live on separate cache lines so that
+  // the two threads do not contend for the same line
+  alignas(CACHE_LINE) std::atomic<uint32_t> _head;
+  alignas(CACHE_LINE) std::atomic<uint32_t> _tail;
+  alignas(CACHE_LINE) uint32_t _capacity;
+  std::unique_ptr<type_t[]> _items;
+};
+
+}  // namespace Tracker
@@ -0,0 +1,101 @@
+#include "sample_pool.h"
+#include "bank.h"
+
+
+namespace Tracker {
+
+sample_pool_t::sample_pool_t(size_t budget)
+  : _budget(budget)
+  , _bytes(0)
+{
+}
+
+std::shared_ptr<const sample_t> sample_pool_t::get(const std::string &path) {
+  {
+    std::lock_guard<std::mutex> guard{ _mutex };
+    auto itt = _index.find(path);
+    if (itt != _index.end()) {
+      // move to the most recently used end
+      _lru.splice(_lru.begin(), _lru, itt->second);
+      return itt->second->sample;
+    }
+  }
+  // load without the lock so other threads are not held up
+  std::shared_ptr<const sample_t> sample = sample_load(path.c_str());
+  if (!sample) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> guard{ _mutex };
+  // another thread may have loaded the same file in the meantime
+  auto itt = _index.find(path);
+  if (itt != _index.end()) {
+    _lru.splice(_lru.begin(), _lru, itt->second);
+    return itt->second->sample;
+  }
+  _lru.push_front(entry_t{ path, sample });
+  _index.emplace(path, _lru.begin());
+  _bytes += sample->bytes();
+  // the new sample is referenced by the caller so it is never trimmed
+  _trim();
+  return sample;
+}
+
+bool sample_pool_t::contains(const std::string &path) const {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  return _index.count(path) != 0;
+}
+
+void sample_pool_t::set_budget(size_t budget) {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  _budget = budget;
+  _trim();
+}
+
+size_t sample_pool_t::budget() const {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  return _budget;
+}
+
+void sample_pool_t::_trim() {
+  if (_budget == 0) {
+    return;
+  }
+  for (auto itt = _lru.end(); itt != _lru.begin() && _bytes > _budget;) {
+    --itt;
+    if (itt->sample.use_count() != 1) {
+      continue;
+    }
+    _bytes -= itt->sample->bytes();
+    _index.erase(itt->path);
+    itt = _lru.erase(itt);
+  }
+}
+
+size_t sample_pool_t::purge() {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  size_t freed = 0;
+  for (auto itt = _lru.begin(); itt != _lru.end();) {
+    if (itt->sample.use_count() == 1) {
+      freed += itt->sample->bytes();
+      _index.erase(itt->path);
+      itt = _lru.erase(itt);
+    }
+    else {
+      ++itt;
+    }
+  }
+  _bytes -= freed;
+  return freed;
+}
+
+size_t sample_pool_t::size() const {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  return _lru.size();
+}
+
+size_t sample_pool_t::bytes() const {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  return _bytes;
+}
+
+}  // namespace Tracker
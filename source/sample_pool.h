@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "tracker.h"
+
+
+namespace Tracker {
+
+// one immutable copy of each loaded sample file
+//
+// the pool, the sample browser and any number of instruments all hold a
+// reference to the same sample so assigning a sample to an instrument
+// never copies sample data. safe to use from any thread.
+//
+// samples are loaded on first use. when the pool holds more than its
+// budget, the least recently used samples that nothing outside the pool
+// references are released. samples in use are never released so the pool
+// may exceed its budget while they are held.
+struct sample_pool_t {
+
+  // a budget of zero keeps every sample
+  explicit sample_pool_t(size_t budget = 0);
+
+  // return the sample for a wav file, loading it on first use
+  // returns nullptr if the file could not be loaded
+  std::shared_ptr<const sample_t> get(const std::string &path);
+
+  // true if the sample is held by the pool, this does not count as a use
+  bool contains(const std::string &path) const;
+
+  // change the budget in bytes, releasing samples to meet it
+  void set_budget(size_t budget);
+
+  size_t budget() const;
+
+  // release samples that are only referenced by the pool
+  // returns the number of bytes released
+  size_t purge();
+
+  // number of samples held
+  size_t size() const;
+
+  // bytes of sample data held
+  size_t bytes() const;
+
+protected:
+  struct entry_t {
+    std::string path;
+    std::shared_ptr<const sample_t> sample;
+  };
+
+  typedef std::list<entry_t> lru_t;
+
+  // release unused samples from the least recently used end until the
+  // pool is within budget, the lock must be held
+  void _trim();
+
+  mutable std::mutex _mutex;
+  // most recently used first
+  lru_t _lru;
+  std::unordered_map<std::string, lru_t::iterator> _index;
+  size_t _budget;
+  size_t _bytes;
+};
+
+}  // namespace Tracker
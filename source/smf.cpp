@@ -0,0 +1,304 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "smf.h"
+
+
+namespace {
+
+struct midi_note_t {
+  // absolute time in ticks
+  uint64_t tick;
+  uint8_t channel;
+  uint8_t key;
+};
+
+// big endian reader over the file contents
+struct reader_t {
+
+  reader_t(const uint8_t *data, size_t size)
+    : _ptr(data)
+    , _end(data + size)
+  {
+  }
+
+  bool eof() const {
+    return _ptr >= _end;
+  }
+
+  size_t left() const {
+    return size_t(_end - _ptr);
+  }
+
+  bool u8(uint8_t &out) {
+    if (_ptr >= _end) {
+      return false;
+    }
+    out = *_ptr++;
+    return true;
+  }
+
+  bool u16(uint32_t &out) {
+    uint8_t a, b;
+    if (!u8(a) || !u8(b)) {
+      return false;
+    }
+    out = (uint32_t(a) << 8) | b;
+    return true;
+  }
+
+  bool u32(uint32_t &out) {
+    uint32_t a, b;
+    if (!u16(a) || !u16(b)) {
+      return false;
+    }
+    out = (a << 16) | b;
+    return true;
+  }
+
+  // midi variable length quantity
+  bool vlq(uint32_t &out) {
+    out = 0;
+    for (int i = 0; i < 4; ++i) {
+      uint8_t c;
+      if (!u8(c)) {
+        return false;
+      }
+      out = (out << 7) | (c & 0x7f);
+      if ((c & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool skip(size_t bytes) {
+    if (bytes > left()) {
+      return false;
+    }
+    _ptr += bytes;
+    return true;
+  }
+
+  const uint8_t *ptr() const {
+    return _ptr;
+  }
+
+protected:
+  const uint8_t *_ptr;
+  const uint8_t *_end;
+};
+
+bool read_file(const char *path, std::vector<uint8_t> &out) {
+  FILE *fd = fopen(path, "rb");
+  if (!fd) {
+    return false;
+  }
+  fseek(fd, 0, SEEK_END);
+  const long size = ftell(fd);
+  fseek(fd, 0, SEEK_SET);
+  bool ok = size > 0;
+  if (ok) {
+    out.resize(size_t(size));
+    ok = fread(out.data(), out.size(), 1, fd) == 1;
+  }
+  fclose(fd);
+  return ok;
+}
+
+// parse one MTrk chunk appending any note on events
+bool parse_track(reader_t rd, std::vector<midi_note_t> &notes, uint32_t &tempo) {
+  uint64_t tick = 0;
+  uint8_t status = 0;
+  while (!rd.eof()) {
+    uint32_t delta;
+    if (!rd.vlq(delta)) {
+      return false;
+    }
+    tick += delta;
+    uint8_t c;
+    if (!rd.u8(c)) {
+      return false;
+    }
+    if (c == 0xff) {
+      // meta event
+      uint8_t type;
+      uint32_t len;
+      if (!rd.u8(type) || !rd.vlq(len) || len > rd.left()) {
+        return false;
+      }
+      if (type == 0x51 && len == 3 && tempo == 0) {
+        const uint8_t *p = rd.ptr();
+        tempo = (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+      }
+      if (type == 0x2f) {
+        // end of track
+        return true;
+      }
+      rd.skip(len);
+      continue;
+    }
+    if (c == 0xf0 || c == 0xf7) {
+      // sysex event
+      uint32_t len;
+      if (!rd.vlq(len) || !rd.skip(len)) {
+        return false;
+      }
+      continue;
+    }
+    uint8_t data0;
+    if (c & 0x80) {
+      status = c;
+      if (!rd.u8(data0)) {
+        return false;
+      }
+    }
+    else {
+      // running status
+      if (status == 0) {
+        return false;
+      }
+      data0 = c;
+    }
+    uint8_t data1 = 0;
+    switch (status & 0xf0) {
+    case 0xc0:  // program change
+    case 0xd0:  // channel pressure
+      break;
+    default:
+      if (!rd.u8(data1)) {
+        return false;
+      }
+      break;
+    }
+    // note on with zero velocity is a note off
+    if ((status & 0xf0) == 0x90 && data1 != 0) {
+      notes.push_back(midi_note_t{ tick, uint8_t(status & 0x0f), uint8_t(data0 & 0x7f) });
+    }
+  }
+  return true;
+}
+
+bool same_notes(const Tracker::pattern_t &a, const Tracker::pattern_t &b) {
+  if (a.notes_head != b.notes_head) {
+    return false;
+  }
+  for (uint32_t i = 0; i < a.notes_head; ++i) {
+    const Tracker::note_t &x = a.notes[i];
+    const Tracker::note_t &y = b.notes[i];
+    if (x.start != y.start || x.note != y.note || x.instrument != y.instrument) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+namespace Tracker {
+
+bool smf_load(const char *path, song_t &song, smf_info_t &info) {
+  info = smf_info_t{};
+
+  std::vector<uint8_t> file;
+  if (!read_file(path, file)) {
+    return false;
+  }
+  reader_t rd{ file.data(), file.size() };
+
+  // header chunk
+  uint32_t id, size, format, tracks, division;
+  if (!rd.u32(id) || id != 0x4d546864 /* MThd */) {
+    return false;
+  }
+  if (!rd.u32(size) || size < 6) {
+    return false;
+  }
+  if (!rd.u16(format) || !rd.u16(tracks) || !rd.u16(division)) {
+    return false;
+  }
+  rd.skip(size - 6);
+  // smpte time division is not supported
+  if (format > 1 || division == 0 || (division & 0x8000)) {
+    return false;
+  }
+
+  std::vector<midi_note_t> notes;
+  uint32_t tempo = 0;
+  while (!rd.eof()) {
+    if (!rd.u32(id) || !rd.u32(size) || size > rd.left()) {
+      return false;
+    }
+    if (id == 0x4d54726b /* MTrk */) {
+      if (!parse_track(reader_t{ rd.ptr(), size }, notes, tempo)) {
+        return false;
+      }
+      ++info.tracks;
+    }
+    rd.skip(size);
+  }
+
+  // tracks are parsed one after another so merge them in time order
+  std::stable_sort(notes.begin(), notes.end(),
+    [](const midi_note_t &a, const midi_note_t &b) { return a.tick < b.tick; });
+
+  if (tempo) {
+    const uint32_t bpm = (60000000u + tempo / 2) / tempo;
+    song.bpm = uint8_t(std::min<uint32_t>(std::max<uint32_t>(bpm, 1), 255));
+  }
+
+  // split the notes into sections of BEATS_IN_PATTERN beats
+  std::vector<pattern_t> sections;
+  for (const auto &n : notes) {
+    const double beat = double(n.tick) / double(division);
+    const uint32_t index = uint32_t(beat / BEATS_IN_PATTERN);
+    if (index >= MAX_ORDERS) {
+      info.too_long = true;
+      return false;
+    }
+    if (index >= sections.size()) {
+      sections.resize(index + 1);
+    }
+    pattern_t &pat = sections[index];
+    if (pat.notes_head >= MAX_NOTES - 1) {
+      ++info.dropped;
+      continue;
+    }
+    const position_t start = position_t(beat - double(index * BEATS_IN_PATTERN));
+    pat.note_insert(note_t{ start, n.key, uint8_t(n.channel % MAX_INSTUMENTS) });
+    info.beats = std::max(info.beats, float(beat));
+    ++info.notes;
+  }
+
+  // play the sections in sequence, repeated sections sharing a pattern
+  uint32_t patterns = 0;
+  for (uint32_t i = 0; i < sections.size(); ++i) {
+    uint32_t p = 0;
+    while (p < patterns && !same_notes(song.patterns[p], sections[i])) {
+      ++p;
+    }
+    if (p == patterns) {
+      if (patterns >= MAX_PATTERNS) {
+        info.too_long = true;
+        return false;
+      }
+      song.patterns[patterns++] = sections[i];
+    }
+    song.orders[i] = uint8_t(p);
+  }
+  song.orders_head = uint8_t(sections.size());
+  return true;
+}
+
+bool is_midi(const char *path) {
+  const char *dot = strrchr(path, '.');
+  if (!dot) {
+    return false;
+  }
+  return strcmp(dot, ".mid") == 0 || strcmp(dot, ".midi") == 0 || strcmp(dot, ".MID") == 0;
+}
+
+}  // namespace Tracker
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+
+#include "tracker.h"
+
+
+namespace Tracker {
+
+// summary of a standard midi file import
+struct smf_info_t {
+
+  smf_info_t()
+    : tracks(0)
+    , notes(0)
+    , dropped(0)
+    , beats(0.f)
+    , too_long(false)
+  {
+  }
+
+  // number of tracks in the file
+  uint32_t tracks;
+  // number of notes imported into the song
+  uint32_t notes;
+  // number of notes that did not fit into the song
+  uint32_t dropped;
+  // length of the imported notes in beats
+  float beats;
+  // true if the import failed as the file needs more patterns or orders
+  // than a song holds
+  bool too_long;
+};
+
+// parse a standard midi file into the patterns and order list of a song
+//
+// each midi channel maps to the instrument with the same index and every
+// BEATS_IN_PATTERN beats becomes an entry in the order list, with sections
+// holding the same notes sharing one pattern. a file needing more than
+// MAX_PATTERNS distinct sections or MAX_ORDERS sections in all is rejected
+// rather than truncated.
+// only the first tempo event is used to set the song bpm and only note on
+// events are imported, as instruments always play their sample to the end.
+bool smf_load(const char *path, song_t &song, smf_info_t &info);
+
+// true if the path has a midi file extension
+bool is_midi(const char *path);
+
+}  // namespace Tracker
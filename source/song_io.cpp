@@ -0,0 +1,171 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "song_io.h"
+#include "bank.h"
+
+
+namespace {
+
+using namespace Tracker;
+
+bool parse_instrument(const char *args, const std::string &song_path, song_t &song,
+                      const sample_loader_t &loader) {
+  unsigned index = 0, root = 0, interp = 0, loop = 0, start = 0, end = 0;
+  float fine = 0.f;
+  int used = 0;
+  if (sscanf(args, "%u %u %f %u %u %u %u%n", &index, &root, &fine, &start, &end,
+             &interp, &loop, &used) < 7) {
+    return false;
+  }
+  if (index >= MAX_INSTUMENTS || root > 127 || interp >= NUM_INTERP || loop >= NUM_LOOP) {
+    return false;
+  }
+  auto &ins = song.instruments[index];
+  ins.root = uint8_t(root);
+  ins.fine = fine;
+  ins.sample_start = start;
+  ins.sample_end = end;
+  ins.interp = interp_t(interp);
+  ins.loop = loop_t(loop);
+  // the wav path is the rest of the line so that it may contain spaces
+  const char *name = args + used;
+  name += strspn(name, " \t");
+  const size_t length = strcspn(name, "\r\n");
+  if (length == 0) {
+    return true;
+  }
+  auto sample = loader(path_resolve(song_path, std::string(name, length)));
+  if (!sample) {
+    return false;
+  }
+  // keep the markers inside the sample in case the file has changed
+  ins.sample_end = std::min(ins.sample_end, sample->size);
+  ins.sample_start = std::min(ins.sample_start, ins.sample_end);
+  // the song is not playing yet so the old sample can go right away
+  ins.set_sample(std::move(sample));
+  return true;
+}
+
+bool parse_order(const char *args, song_t &song) {
+  unsigned pattern = 0;
+  int used = 0;
+  while (sscanf(args, "%u%n", &pattern, &used) == 1) {
+    if (pattern >= MAX_PATTERNS || song.orders_head >= MAX_ORDERS) {
+      return false;
+    }
+    song.orders[song.orders_head++] = uint8_t(pattern);
+    args += used;
+  }
+  return true;
+}
+
+bool parse_note(const char *args, song_t &song) {
+  unsigned pattern = 0, note = 0, instrument = 0;
+  float start = 0.f;
+  if (sscanf(args, "%u %f %u %u", &pattern, &start, &note, &instrument) != 4) {
+    return false;
+  }
+  if (pattern >= MAX_PATTERNS || note > 127 || instrument >= MAX_INSTUMENTS) {
+    return false;
+  }
+  if (start < 0.f || start >= float(BEATS_IN_PATTERN)) {
+    return false;
+  }
+  auto &pat = song.patterns[pattern];
+  // matches the note_insert() capacity
+  if (pat.notes_head >= MAX_NOTES - 1) {
+    return false;
+  }
+  pat.note_insert(note_t{ start, uint8_t(note), uint8_t(instrument) });
+  return true;
+}
+
+}  // namespace
+
+namespace Tracker {
+
+bool song_save(const char *path, const song_t &song) {
+  FILE *fd = fopen(path, "w");
+  if (!fd) {
+    return false;
+  }
+  fprintf(fd, "# tracker song\n");
+  fprintf(fd, "bpm %u\n", unsigned(song.bpm));
+  for (uint32_t i = 0; i < MAX_INSTUMENTS; ++i) {
+    const auto &ins = song.instruments[i];
+    const sample_t *s = ins.sample();
+    fprintf(fd, "instrument %u %u %.9g %u %u %u %u", i, unsigned(ins.root), ins.fine,
+            ins.sample_start, ins.sample_end, unsigned(ins.interp), unsigned(ins.loop));
+    if (s && !s->path.empty()) {
+      fprintf(fd, " %s", s->path.c_str());
+    }
+    fprintf(fd, "\n");
+  }
+  if (song.orders_head) {
+    fprintf(fd, "order");
+    for (uint32_t i = 0; i < song.orders_head; ++i) {
+      fprintf(fd, " %u", unsigned(song.orders[i]));
+    }
+    fprintf(fd, "\n");
+  }
+  for (uint32_t p = 0; p < MAX_PATTERNS; ++p) {
+    const auto &pat = song.patterns[p];
+    for (uint32_t i = 0; i < pat.notes_head; ++i) {
+      const note_t &n = pat.notes[i];
+      fprintf(fd, "note %u %.9g %u %u\n", p, n.start, unsigned(n.note), unsigned(n.instrument));
+    }
+  }
+  const bool ok = !ferror(fd);
+  return (fclose(fd) == 0) && ok;
+}
+
+bool song_load(const char *path, song_t &song) {
+  return song_load(path, song, [](const std::string &name) -> std::shared_ptr<const sample_t> {
+    return sample_load(name.c_str());
+  });
+}
+
+bool song_load(const char *path, song_t &song, const sample_loader_t &loader) {
+  FILE *fd = fopen(path, "r");
+  if (!fd) {
+    return false;
+  }
+  bool ok = true;
+  char line[1024];
+  while (ok && fgets(line, sizeof(line), fd)) {
+    if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+      continue;
+    }
+    char key[16] = { 0 };
+    int used = 0;
+    if (sscanf(line, "%15s%n", key, &used) != 1) {
+      ok = false;
+      break;
+    }
+    const char *args = line + used;
+    if (strcmp(key, "bpm") == 0) {
+      unsigned bpm = 0;
+      ok = sscanf(args, "%u", &bpm) == 1 && bpm > 0 && bpm <= 255;
+      song.bpm = uint8_t(bpm);
+    }
+    else if (strcmp(key, "instrument") == 0) {
+      ok = parse_instrument(args, path, song, loader);
+    }
+    else if (strcmp(key, "order") == 0) {
+      ok = parse_order(args, song);
+    }
+    else if (strcmp(key, "note") == 0) {
+      ok = parse_note(args, song);
+    }
+    else {
+      ok = false;
+    }
+  }
+  fclose(fd);
+  return ok;
+}
+
+}  // namespace Tracker
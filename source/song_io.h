@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "tracker.h"
+
+
+namespace Tracker {
+
+// return the sample for a path or nullptr if it could not be loaded
+typedef std::function<std::shared_ptr<const sample_t>(const std::string &path)> sample_loader_t;
+
+// songs are saved as text with one item per line:
+//   bpm <bpm>
+//   instrument <index> <root> <fine> <start> <end> <interp> <loop> [wav path]
+//   order <pattern> ...
+//   note <pattern> <start> <note> <instrument>
+// blank lines and lines starting with '#' are ignored. sample paths are
+// written as they were loaded and relative paths are resolved against the
+// song file when loading.
+
+// save a song, instruments without a sample file are saved without a path
+bool song_save(const char *path, const song_t &song);
+
+// load a song into a newly constructed song_t
+// samples are loaded with sample_load() unless a loader is given
+bool song_load(const char *path, song_t &song);
+bool song_load(const char *path, song_t &song, const sample_loader_t &loader);
+
+}  // namespace Tracker
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+
+#include "memory.h"
+
+
+namespace Tracker {
+
+// lock free window onto an audio stream for one writer and any readers
+//
+// the writer copies each block into a circular buffer and never waits or
+// allocates, old audio is simply overwritten. readers keep their own
+// cursor and copy out whatever is new, skipping ahead if they fell so far
+// behind that the writer has overwritten what they had not read yet. half
+// the buffer is kept back for a block the writer may be part way through,
+// so readers only see the newest capacity / 2 samples.
+struct tap_t {
+
+  // capacity is rounded up to a power of two
+  explicit tap_t(uint32_t capacity)
+    : _written(0)
+  {
+    _capacity = 1;
+    while (_capacity < capacity) {
+      _capacity <<= 1;
+    }
+    _data.reset(new int16_t[_capacity]());
+  }
+
+  // writer: append count samples
+  void write(const int16_t *in, uint32_t count) {
+    uint64_t pos = _written.load(std::memory_order_relaxed);
+    const uint32_t limit = _capacity / 2;
+    if (count > limit) {
+      // only the newest samples could be read
+      in += count - limit;
+      pos += count - limit;
+      count = limit;
+    }
+    const uint32_t offset = uint32_t(pos & (_capacity - 1));
+    const uint32_t first = std::min(count, _capacity - offset);
+    memcpy(_data.get() + offset, in, first * sizeof(int16_t));
+    memcpy(_data.get(), in + first, (count - first) * sizeof(int16_t));
+    _written.store(pos + count, std::memory_order_release);
+  }
+
+  // reader: copy up to max samples written since cursor into out, advancing
+  // cursor and returning the number copied. samples overwritten before they
+  // could be read are skipped.
+  uint32_t read(uint64_t &cursor, int16_t *out, uint32_t max) const {
+    const uint64_t written = _written.load(std::memory_order_acquire);
+    const uint32_t limit = _capacity / 2;
+    if (written - cursor > limit) {
+      // leave the writer room for one more block while we copy
+      cursor = written - limit / 2;
+    }
+    const uint32_t count = uint32_t(std::min<uint64_t>(written - cursor, max));
+    const uint32_t offset = uint32_t(cursor & (_capacity - 1));
+    const uint32_t first = std::min(count, _capacity - offset);
+    memcpy(out, _data.get() + offset, first * sizeof(int16_t));
+    memcpy(out + first, _data.get(), (count - first) * sizeof(int16_t));
+    // if the writer caught up with us during the copy the result may be
+    // torn, so drop it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t after = _written.load(std::memory_order_relaxed);
+    if (after - cursor > limit) {
+      cursor = after;
+      return 0;
+    }
+    cursor += count;
+    return count;
+  }
+
+  // total samples written
+  uint64_t written() const {
+    return _written.load(std::memory_order_acquire);
+  }
+
+  uint32_t capacity() const {
+    return _capacity;
+  }
+
+protected:
+  alignas(CACHE_LINE) std::atomic<uint64_t> _written;
+  alignas(CACHE_LINE) uint32_t _capacity;
+  std::unique_ptr<int16_t[]> _data;
+};
+
+}  // namespace Tracker
@@ -0,0 +1,61 @@
+#include "thread_pool.h"
+#include "trace.h"
+
+
+thread_pool_t::thread_pool_t(uint32_t num_threads)
+  : _busy(0)
+  , _quit(false)
+{
+  if (num_threads == 0) {
+    num_threads = 1;
+  }
+  for (uint32_t i = 0; i < num_threads; ++i) {
+    _threads.emplace_back([this]() { _worker(); });
+  }
+}
+
+thread_pool_t::~thread_pool_t() {
+  {
+    std::lock_guard<std::mutex> guard{ _mutex };
+    _quit = true;
+  }
+  _wake.notify_all();
+  for (auto &t : _threads) {
+    t.join();
+  }
+}
+
+void thread_pool_t::push(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> guard{ _mutex };
+    _jobs.push_back(std::move(job));
+  }
+  _wake.notify_one();
+}
+
+void thread_pool_t::wait() {
+  std::unique_lock<std::mutex> lock{ _mutex };
+  _idle.wait(lock, [this]() { return _jobs.empty() && _busy == 0; });
+}
+
+void thread_pool_t::_worker() {
+  TRACE_THREAD("worker");
+  std::unique_lock<std::mutex> lock{ _mutex };
+  for (;;) {
+    _wake.wait(lock, [this]() { return _quit || !_jobs.empty(); });
+    // finish any outstanding jobs before quitting
+    if (_jobs.empty()) {
+      return;
+    }
+    auto job = std::move(_jobs.front());
+    _jobs.pop_front();
+    ++_busy;
+    lock.unlock();
+    job();
+    lock.lock();
+    --_busy;
+    if (_jobs.empty() && _busy == 0) {
+      _idle.notify_all();
+    }
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <deque>
+
+
+// a fixed set of worker threads consuming a fifo of jobs
+// with a single thread, jobs are executed in the order they were pushed
+struct thread_pool_t {
+
+  thread_pool_t(uint32_t num_threads);
+  ~thread_pool_t();
+
+  // queue a job for execution on a worker thread
+  void push(std::function<void()> job);
+
+  // block until the job queue is empty and all workers are idle
+  void wait();
+
+  uint32_t num_threads() const {
+    return uint32_t(_threads.size());
+  }
+
+protected:
+  void _worker();
+
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _idle;
+  std::deque<std::function<void()>> _jobs;
+  std::vector<std::thread> _threads;
+  // number of jobs currently being executed
+  uint32_t _busy;
+  bool _quit;
+};
@@ -0,0 +1,158 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "trace.h"
+
+
+#if defined(TRACKER_TRACE)
+
+namespace {
+
+enum {
+  // zones kept per thread, a power of two
+  TRACE_EVENTS = 1 << 16,
+};
+
+struct event_t {
+  const char *name;
+  uint64_t start;
+  uint64_t end;
+};
+
+// zones recorded by one thread, written only by that thread
+struct buffer_t {
+
+  explicit buffer_t(uint32_t id)
+    : id(id)
+    , name(nullptr)
+    , written(0)
+    , events(new event_t[TRACE_EVENTS])
+  {
+  }
+
+  const uint32_t id;
+  std::atomic<const char *> name;
+  // total zones recorded
+  std::atomic<uint64_t> written;
+  std::unique_ptr<event_t[]> events;
+};
+
+// every thread's buffer, never freed as trace_save() may read the buffer
+// of a thread that has since exited
+std::mutex _mutex;
+std::vector<buffer_t *> _buffers;
+
+thread_local buffer_t *_local = nullptr;
+
+buffer_t &local_buffer() {
+  if (!_local) {
+    std::lock_guard<std::mutex> guard{ _mutex };
+    _local = new buffer_t(uint32_t(_buffers.size() + 1));
+    _buffers.push_back(_local);
+  }
+  return *_local;
+}
+
+uint64_t now_ns() {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// copy out the zones of a buffer, skipping any the writer may have been
+// overwriting during the copy
+void collect(const buffer_t &b, std::vector<event_t> &out) {
+  const uint64_t written = b.written.load(std::memory_order_acquire);
+  const uint64_t first = (written > TRACE_EVENTS) ? written - TRACE_EVENTS : 0;
+  std::vector<event_t> events;
+  events.reserve(size_t(written - first));
+  for (uint64_t i = first; i < written; ++i) {
+    events.push_back(b.events[i & (TRACE_EVENTS - 1)]);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t after = b.written.load(std::memory_order_relaxed);
+  // the slot of zone i is reused by zone i + TRACE_EVENTS
+  const uint64_t valid = (after >= TRACE_EVENTS) ? after - TRACE_EVENTS + 1 : 0;
+  const size_t skip = size_t(std::min(written, std::max(valid, first)) - first);
+  out.assign(events.begin() + skip, events.end());
+}
+
+}  // namespace
+
+namespace Tracker {
+
+trace_zone_t::trace_zone_t(const char *name)
+  : _name(name)
+  , _start(now_ns())
+{
+}
+
+trace_zone_t::~trace_zone_t() {
+  const uint64_t end = now_ns();
+  buffer_t &b = local_buffer();
+  const uint64_t w = b.written.load(std::memory_order_relaxed);
+  b.events[w & (TRACE_EVENTS - 1)] = event_t{ _name, _start, end };
+  b.written.store(w + 1, std::memory_order_release);
+}
+
+void trace_thread(const char *name) {
+  local_buffer().name.store(name);
+}
+
+bool trace_save(const char *path) {
+  std::vector<buffer_t *> buffers;
+  {
+    std::lock_guard<std::mutex> guard{ _mutex };
+    buffers = _buffers;
+  }
+  std::vector<std::vector<event_t>> events(buffers.size());
+  uint64_t base = UINT64_MAX;
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    collect(*buffers[i], events[i]);
+    for (const auto &e : events[i]) {
+      base = std::min(base, e.start);
+    }
+  }
+  FILE *fd = fopen(path, "w");
+  if (!fd) {
+    return false;
+  }
+  // times are in microseconds from the first zone
+  fprintf(fd, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    const buffer_t &b = *buffers[i];
+    if (const char *name = b.name.load()) {
+      fprintf(fd, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+        "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", b.id, name);
+      first = false;
+    }
+    for (const auto &e : events[i]) {
+      fprintf(fd, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+        first ? "" : ",\n", e.name, b.id, double(e.start - base) / 1000.0,
+        double(e.end - e.start) / 1000.0);
+      first = false;
+    }
+  }
+  fprintf(fd, "\n]}\n");
+  return fclose(fd) == 0;
+}
+
+}  // namespace Tracker
+
+#else
+
+namespace Tracker {
+
+bool trace_save(const char *) {
+  return false;
+}
+
+}  // namespace Tracker
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+
+
+namespace Tracker {
+
+// scoped trace zones recorded per thread and saved as chrome trace json
+//
+// zones are only recorded when built with TRACKER_TRACE defined, otherwise
+// TRACE_ZONE() and TRACE_THREAD() compile to nothing. each thread writes
+// its zones into a fixed size buffer of its own without locks, so zones may
+// be used on the audio thread. the buffer is allocated by the first zone or
+// TRACE_THREAD() on a thread, and once full the oldest zones are
+// overwritten. trace_save() may be called from any thread at any time and
+// the file it writes opens in chrome://tracing or ui.perfetto.dev.
+//
+//   void player_t::render(...) {
+//     TRACE_ZONE("player_t::render");
+//     ...
+//   }
+
+#if defined(TRACKER_TRACE)
+
+// records the time from construction to destruction
+struct trace_zone_t {
+
+  // name must outlive the trace, normally a string literal
+  explicit trace_zone_t(const char *name);
+  ~trace_zone_t();
+
+protected:
+  const char *_name;
+  uint64_t _start;
+};
+
+// name the calling thread in the trace
+void trace_thread(const char *name);
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) ::Tracker::trace_zone_t TRACE_CONCAT(_trace_zone_, __LINE__){ name }
+#define TRACE_THREAD(name) ::Tracker::trace_thread(name)
+
+#else
+
+#define TRACE_ZONE(name)
+#define TRACE_THREAD(name)
+
+#endif
+
+// true if zones are being recorded
+inline bool trace_enabled() {
+#if defined(TRACKER_TRACE)
+  return true;
+#else
+  return false;
+#endif
+}
+
+// write the zones recorded so far on every thread to a chrome trace json
+// file, returns false if it could not be written or tracing is compiled out
+bool trace_save(const char *path);
+
+}  // namespace Tracker
@@ -1,7 +1,12 @@
 #include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
 #include <mutex>
 
 #include "tracker.h"
+#include "kernels.h"
+#include "trace.h"
 
 //  A4=69 (440hz)
 //
@@ -30,9 +35,9 @@ float samples_to_beats(uint32_t sample_rate, uint32_t bpm, uint32_t samples) {
   return float(seconds * bps);
 }
 
-float note_to_rate(float note, float root) {
+double note_to_rate(float note, float root) {
   // where root is typicaly 69
-  return powf(2.f, ((note - 69) + (root - 69)) / 12.f);
+  return pow(2.0, ((double(note) - 69) + (double(root) - 69)) / 12.0);
 }
 
 }  // namespace
@@ -42,7 +47,64 @@ namespace Tracker {
 // number of beats in a pattern
 static const position_t PAT_END_POS = float(BEATS_IN_PATTERN);
 
+std::shared_ptr<const sample_t> instrument_t::set_sample(std::shared_ptr<const sample_t> s) {
+  // publish the new sample to the audio thread before giving up our
+  // reference to the old one
+  _sample.store(s.get());
+  std::swap(_sample_ref, s);
+  return s;
+}
+
+void sample_bin_t::retire(std::initializer_list<const player_t *> players,
+                          std::shared_ptr<const sample_t> s) {
+  if (!s) {
+    return;
+  }
+  // a render pass that is in flight now may have loaded the old pointer, but
+  // it will have finished by the time the epoch moves past this value
+  entry_t entry;
+  for (const player_t *p : players) {
+    entry.epochs.push_back(p->epoch());
+  }
+  entry.sample = std::move(s);
+  std::lock_guard<std::mutex> guard{ _mutex };
+  _entries.push_back(std::move(entry));
+}
+
+void sample_bin_t::collect(std::initializer_list<const player_t *> players) {
+  std::vector<uint64_t> epochs;
+  for (const player_t *p : players) {
+    epochs.push_back(p->epoch());
+  }
+  // an entry is alive while any player has not moved past its epoch
+  const auto alive = [&epochs](const entry_t &e) {
+    for (size_t i = 0; i < e.epochs.size() && i < epochs.size(); ++i) {
+      if (e.epochs[i] >= epochs[i]) {
+        return true;
+      }
+    }
+    return false;
+  };
+  std::vector<entry_t> dead;
+  {
+    std::lock_guard<std::mutex> guard{ _mutex };
+    auto itt = std::partition(_entries.begin(), _entries.end(), alive);
+    std::move(itt, _entries.end(), std::back_inserter(dead));
+    _entries.erase(itt, _entries.end());
+  }
+  // samples are released here as dead goes out of scope
+}
+
+size_t sample_bin_t::size() const {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  return _entries.size();
+}
+
 void pattern_t::note_insert(const note_t &n) {
+  // notes_head can not count beyond this
+  if (notes_head >= MAX_NOTES - 1) {
+    return;
+  }
   // find insertion point in array
   uint32_t i = 0;
   for (; i < notes_head; ++i) {
@@ -57,6 +119,7 @@ void pattern_t::note_insert(const note_t &n) {
   // insert into the array
   notes[i] = n;
   ++notes_head;
+  ++revision;
 }
 
 void pattern_t::note_remove(const note_t &n) {
@@ -76,17 +139,43 @@ void pattern_t::note_remove(const note_t &n) {
       notes[i] = notes[i + 1];
     }
     --notes_head;
+    ++revision;
     break;
   }
 }
 
+void pattern_t::note_range(position_t start, position_t end, uint32_t &first, uint32_t &last) const {
+  const note_t *begin = notes.data();
+  const note_t *head = begin + notes_head;
+  // notes are sorted by start time so we can binary search both ends
+  const note_t *lo = std::lower_bound(begin, head, start,
+    [](const note_t &n, position_t p) { return n.start < p; });
+  const note_t *hi = std::lower_bound(lo, head, end,
+    [](const note_t &n, position_t p) { return n.start < p; });
+  first = uint32_t(lo - begin);
+  last = uint32_t(hi - begin);
+}
+
 void playing_note_t::_trigger(const player_t &player, const note_t &note) {
+  TRACE_ZONE("playing_note_t::_trigger");
   const song_t &song = player._song;
   const instrument_t &inst = song.instruments[note.instrument];
+  const sample_t *s = inst.sample();
+  if (!s) {
+    // nothing to play so leave this voice free
+    step = 0;
+    return;
+  }
   instrument = note.instrument;
-  position = position_t(inst.sample_start);
-  step = (float(inst.sample.sample_rate) / float(player._sample_rate)) *
+  sample = s;
+  loop = (inst.loop != LOOP_NONE);
+  // pick the kernel once here so rendering needs no mode checks
+  kernel = select_kernel(s->format, s->channels, inst.interp, inst.loop);
+  phase = phase_t(inst.sample_start) << PHASE_BITS;
+  const double rate = (double(s->sample_rate) / double(player._sample_rate)) *
     note_to_rate(note.note + inst.fine, inst.root);
+  // a step that rounds to zero would mark this voice as free
+  step = std::max<phase_t>(1, phase_t(rate * double(1ull << PHASE_BITS)));
 }
 
 void player_t::stop() {
@@ -94,11 +183,31 @@ void player_t::stop() {
   _playing = false;
   _playback_pos = 0;
   _note = nullptr;
+  // looping notes would otherwise resume forever on the next play
+  for (auto &n : _note_stack) {
+    n.step = 0;
+  }
 }
 
 void player_t::play() {
   std::lock_guard<std::mutex> guard{ _mutex };
   _playing = true;
+  _song_mode = false;
+  _song_end = false;
+  _playback_pos = 0;
+  _note = nullptr;
+}
+
+void player_t::play_song() {
+  std::lock_guard<std::mutex> guard{ _mutex };
+  _playing = true;
+  _song_mode = true;
+  _order = 0;
+  _song_end = (_song.orders_head == 0);
+  if (!_song_end) {
+    assert(_song.orders[0] < _song.patterns.size());
+    _pattern = &_song.patterns[_song.orders[0]];
+  }
   _playback_pos = 0;
   _note = nullptr;
 }
@@ -113,9 +222,33 @@ void player_t::set_pattern(uint32_t index) {
 
 void player_t::play_note(const note_t &note) {
   std::lock_guard<std::mutex> guard{ _mutex };
+  _start_note(note);
+}
+
+void player_t::render_notes(int16_t *out, uint32_t samples) {
+  TRACE_ZONE("player_t::render_notes");
+  if (_mutex.try_lock()) {
+    for (auto &n : _note_stack) {
+      if (n.step != 0 && n._render_samples(*this, out, samples)) {
+        n.step = 0;
+      }
+    }
+    _mutex.unlock();
+  }
+  ++_epoch;
+}
+
+void player_t::_start_note(const note_t &note) {
+  // a looping note never finishes by itself so it is cut by the next
+  // note on the same instrument
+  for (auto &n : _note_stack) {
+    if (n.step != 0 && n.loop && n.instrument == note.instrument) {
+      n.step = 0;
+    }
+  }
   // insert into the note stack
   for (auto &n : _note_stack) {
-    if (n.step == 0.f) {
+    if (n.step == 0) {
       n._trigger(*this, note);
       return;
     }
@@ -145,9 +278,19 @@ void player_t::_on_pattern_end() {
   // restart
   _playback_pos = 0;
   _note = nullptr;
+  if (_song_mode) {
+    // advance to the next pattern in the order list
+    if (++_order >= _song.orders_head) {
+      _song_end = true;
+      return;
+    }
+    assert(_song.orders[_order] < _song.patterns.size());
+    _pattern = &_song.patterns[_song.orders[_order]];
+  }
 }
 
 void player_t::render(int16_t *out, uint32_t samples) {
+  TRACE_ZONE("player_t::render");
   // grab a lock so that no-one can change our data while
   // we are using it
   if (_mutex.try_lock()) {
@@ -164,9 +307,60 @@ void player_t::render(int16_t *out, uint32_t samples) {
   else {
     // clear samples?
   }
+  // signal to the sample bin that we are no longer holding onto any
+  // samples we loaded during this pass
+  ++_epoch;
+}
+
+void player_t::render_stems(int16_t *const *stems, uint32_t samples) {
+  TRACE_ZONE("player_t::render_stems");
+  if (_mutex.try_lock()) {
+    if (_playing) {
+      std::array<int16_t *, MAX_INSTUMENTS> outs;
+      std::copy(stems, stems + MAX_INSTUMENTS, outs.begin());
+      while (samples) {
+        const uint32_t done = _render_samples(outs.data(), samples);
+        samples -= done;
+        for (auto &o : outs) {
+          o += done;
+        }
+      }
+    }
+    _mutex.unlock();
+  }
+  ++_epoch;
 }
 
 uint32_t player_t::_render_samples(int16_t *out, uint32_t samples) {
+  std::array<int16_t *, MAX_INSTUMENTS> outs;
+  outs.fill(out);
+  return _render_samples(outs.data(), samples);
+}
+
+uint32_t player_t::_render_samples(int16_t *const *outs, uint32_t samples) {
+  TRACE_ZONE("player_t::_render_samples");
+  if (_song_end) {
+    // the song is over so just let the remaining notes ring out
+    bool active = false;
+    for (auto &n : _note_stack) {
+      if (n.step == 0) {
+        continue;
+      }
+      // looping notes would ring forever
+      if (n.loop) {
+        n.step = 0;
+        continue;
+      }
+      if (n._render_samples(*this, outs[n.instrument], samples)) {
+        n.step = 0;
+      }
+      else {
+        active = true;
+      }
+    }
+    _playing = active;
+    return samples;
+  }
   // get the next note
   const note_t *next = _next_note(_note);
 
@@ -183,13 +377,13 @@ uint32_t player_t::_render_samples(int16_t *out, uint32_t samples) {
   // render each note in turn
   for (auto &n : _note_stack) {
     // skip notes that are not playing
-    if (n.step == 0.f) {
+    if (n.step == 0) {
       continue;
     }
     // render this instrument
-    if (n._render_samples(*this, out, num_samples)) {
+    if (n._render_samples(*this, outs[n.instrument], num_samples)) {
       // sample has finished
-      n.step = 0.f;
+      n.step = 0;
     }
   }
   // update the playback position
@@ -213,23 +407,24 @@ uint32_t player_t::_render_samples(int16_t *out, uint32_t samples) {
 }
 
 bool playing_note_t::_render_samples(const player_t &player, int16_t *out, uint32_t samples) {
-  if (step == 0.f) {
+  if (step == 0) {
     return true;
   }
   const song_t &song = player._song;
   const instrument_t &inst = song.instruments[instrument];
-  const int16_t *samp = inst.sample.data.get();
-  for (uint32_t i = 0; i < samples; ++i) {
-    const uint32_t p = uint32_t(position);
-    if (p >= inst.sample_end) {
-      // note has finished
-      step = 0.f;
-      return true;
-    }
-    // we mix with the output stream here
-    out[i] += (int32_t(samp[p]) * 12) >> 8;
-    // increment the playback position
-    position += step;
+  // load the sample once for this block as the ui thread may swap it at
+  // any time, but will not release it until this render pass has finished
+  const sample_t *s = inst.sample();
+  if (s != sample) {
+    // the sample was removed or replaced so the kernel and step chosen
+    // when this note was triggered no longer apply
+    step = 0;
+    return true;
+  }
+  if (kernel(phase, step, *s, inst.sample_start, inst.sample_end, out, samples)) {
+    // note has finished
+    step = 0;
+    return true;
   }
   return false;
 }
@@ -237,18 +432,8 @@ bool playing_note_t::_render_samples(const player_t &player, int16_t *out, uint3
 void player_t::_on_note(const note_t *note) {
   // we have now reached this note
   _note = note;
-  // 
-  playing_note_t *out = nullptr;
-  for (auto &n : _note_stack) {
-    if (n.step == 0.f) {
-      out = &n;
-      break;
-    }
-  }
-  if (out) {
-    // trigger the new note
-    out->_trigger(*this, *note);
-  }
+  // trigger the new note
+  _start_note(*note);
 }
 
 }  // namespace Tracker
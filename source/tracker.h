@@ -1,8 +1,17 @@
-#pragma
+#pragma once
 #include <cstdint>
+#include <cstring>
 #include <memory>
+#include <new>
 #include <array>
+#include <atomic>
+#include <initializer_list>
 #include <mutex>
+#include <string>
+#include <vector>
+
+#include "peaks.h"
+#include "memory.h"
 
 
 namespace Tracker {
@@ -14,10 +23,13 @@ struct pattern_t;
 struct song_t;
 struct playing_note_t;
 struct player_t;
+struct sample_bin_t;
+struct render_cache_t;
 
 enum {
   MAX_INSTUMENTS = 16,
   MAX_PATTERNS = 16,
+  MAX_ORDERS = 128,
   MAX_NOTES = 256,
   MAX_NOTES_PLAYING = 8,
   BEATS_IN_PATTERN = 16,
@@ -26,20 +38,112 @@ enum {
 // position is actually the number of beats since the pattern start
 typedef float position_t;
 
+// sample playback phase in 32.32 fixed point, the upper 32 bits are the
+// sample index and the lower 32 bits the fraction between samples
+typedef uint64_t phase_t;
+
+enum {
+  PHASE_BITS = 32,
+};
+
+// storage format of sample data
+enum sample_format_t {
+  SAMPLE_S8,
+  SAMPLE_S16,
+  // 8 bit mu-law
+  SAMPLE_ULAW,
+  // 4 bit ima adpcm in independently decodable blocks
+  SAMPLE_ADPCM,
+  NUM_SAMPLE_FORMATS,
+};
+
+enum {
+  // zeroed bytes after the sample data so kernels may read a frame past
+  // the end marker without checking
+  SAMPLE_PAD = CACHE_LINE,
+  // frames per channel in one adpcm block
+  ADPCM_BLOCK_FRAMES = 64,
+  // per channel block header, 16 bit predictor and 8 bit step index
+  ADPCM_HEADER_BYTES = 4,
+};
+
+// how a voice reads between sample frames
+enum interp_t {
+  INTERP_NEAREST,
+  INTERP_LINEAR,
+  NUM_INTERP,
+};
+
+// what a voice does when it reaches the end marker
+enum loop_t {
+  // stop the voice
+  LOOP_NONE,
+  // jump back to the start marker
+  LOOP_FORWARD,
+  NUM_LOOP,
+};
+
 struct sample_t {
 
   sample_t()
     : size(0)
     , sample_rate(1)
+    , channels(1)
+    , format(SAMPLE_S16)
   {
   }
 
-  // number of samples
+  // allocate space for size frames in the current format from the sample
+  // arena followed by SAMPLE_PAD zeroed bytes
+  // the data is cache line aligned and throws std::bad_alloc on failure
+  void alloc(uint32_t frames) {
+    size = frames;
+    data.reset(static_cast<uint8_t *>(sample_arena().alloc(bytes() + SAMPLE_PAD)));
+    if (!data) {
+      throw std::bad_alloc();
+    }
+    memset(data.get() + bytes(), 0, SAMPLE_PAD);
+  }
+
+  // size of the sample data in bytes
+  size_t bytes() const {
+    if (format == SAMPLE_ADPCM) {
+      const size_t blocks = (size_t(size) + ADPCM_BLOCK_FRAMES - 1) / ADPCM_BLOCK_FRAMES;
+      return blocks * adpcm_block_bytes();
+    }
+    return size_t(size) * channels * ((format == SAMPLE_S16) ? 2 : 1);
+  }
+
+  // size of one adpcm block holding every channel
+  uint32_t adpcm_block_bytes() const {
+    return channels * (ADPCM_HEADER_BYTES + ADPCM_BLOCK_FRAMES / 2);
+  }
+
+  template <typename type_t> type_t *get() {
+    return reinterpret_cast<type_t *>(data.get());
+  }
+
+  template <typename type_t> const type_t *get() const {
+    return reinterpret_cast<const type_t *>(data.get());
+  }
+
+  // return one frame mixed to mono at 16 bits
+  // this is for display and analysis, voices use the render kernels
+  int16_t frame(uint32_t i) const;
+
+  // number of frames
   uint32_t size;
   // sample rate
   uint32_t sample_rate;
+  // number of interleaved channels, 1 or 2
+  uint32_t channels;
+  sample_format_t format;
   // sample data
-  std::unique_ptr<int16_t[]> data;
+  std::unique_ptr<uint8_t[], sample_delete_t> data;
+  // waveform summary for display
+  peaks_t peaks;
+  // file this sample was loaded from, empty if it was generated
+  std::string path;
 };
 
 struct instrument_t {
@@ -49,17 +153,43 @@ struct instrument_t {
     , fine(0.f)
     , sample_start(0)
     , sample_end(0)
+    , interp(INTERP_NEAREST)
+    , loop(LOOP_NONE)
+    , _sample(nullptr)
   {
   }
 
+  // return the current sample or nullptr if there is none
+  // this is safe to call from the audio thread
+  const sample_t *sample() const {
+    return _sample.load();
+  }
+
+  // install a new sample and return the one it replaced
+  // the audio thread may still be reading the old sample so it should be
+  // handed to a sample_bin_t rather than released here
+  std::shared_ptr<const sample_t> set_sample(std::shared_ptr<const sample_t> s);
+
+  // return an owning reference to the current sample
+  // only the thread calling set_sample() may use this
+  std::shared_ptr<const sample_t> sample_ref() const {
+    return _sample_ref;
+  }
+
   // root semitone
   uint8_t root;
   float fine;
   // sample loop markes
   uint32_t sample_start;
   uint32_t sample_end;
-  // sample data
-  sample_t sample;
+  interp_t interp;
+  loop_t loop;
+
+protected:
+  // owning reference to the current sample
+  std::shared_ptr<const sample_t> _sample_ref;
+  // sample as seen by the audio thread
+  std::atomic<const sample_t *> _sample;
 };
 
 struct note_t {
@@ -89,6 +219,7 @@ struct pattern_t {
 
   pattern_t()
     : notes_head(0)
+    , revision(0)
   {
   }
 
@@ -96,8 +227,14 @@ struct pattern_t {
 
   void note_remove(const note_t &n);
 
+  // find the notes that start within [start, end) returning the index of
+  // the first note and one past the last note
+  void note_range(position_t start, position_t end, uint32_t &first, uint32_t &last) const;
+
   // notes in the pattern sorted by start time
   uint8_t notes_head;
+  // incremented each time the notes change
+  uint32_t revision;
   std::array<note_t, MAX_NOTES> notes;
 };
 
@@ -105,29 +242,49 @@ struct song_t {
 
   song_t()
     : bpm(120)
+    , orders_head(0)
   {}
 
   uint8_t bpm;
 
   std::array<instrument_t, MAX_INSTUMENTS> instruments;
   std::array<pattern_t, MAX_PATTERNS> patterns;
+
+  // pattern indices in the order they are played by play_song()
+  uint8_t orders_head;
+  std::array<uint8_t, MAX_ORDERS> orders;
 };
 
+// mix one voice into out for up to samples output samples, advancing phase
+// and returning true if the voice reached the end of its sample
+typedef bool (*kernel_t)(phase_t &phase, phase_t step, const sample_t &sample,
+                         uint32_t start, uint32_t end, int16_t *out, uint32_t samples);
+
 struct playing_note_t {
 
   playing_note_t()
     : instrument(0)
-    , step(0.f)
-    , position(0)
+    , step(0)
+    , phase(0)
+    , loop(false)
+    , sample(nullptr)
+    , kernel(nullptr)
   {
   }
 
   // instrument index
   uint8_t instrument;
-  // instrument sample step per output sample
-  float step;
+  // instrument sample step per output sample, zero when the voice is free
+  phase_t step;
   // instrument sample position
-  position_t position;
+  phase_t phase;
+  // true if this voice will loop until it is stopped
+  bool loop;
+  // sample this voice was triggered with, only used to detect that the
+  // instrument sample has since been replaced
+  const sample_t *sample;
+  // render kernel chosen when the voice was triggered
+  kernel_t kernel;
 
   void _trigger(const player_t &player, const note_t &note);
 
@@ -142,22 +299,50 @@ struct player_t {
     : _song(song)
     , _pattern(song.patterns.data())
     , _playing(false)
+    , _song_mode(false)
+    , _song_end(false)
+    , _order(0)
     , _playback_pos{0}
     , _note(nullptr)
     , _sample_rate(sample_rate)
+    , _epoch(0)
   {
   }
 
   void render(int16_t *out, uint32_t samples);
 
+  // render with the voices of each instrument mixed into its own output,
+  // stems[i] for instrument i, rather than all into one. adding the stems
+  // together gives exactly what render() would have.
+  void render_stems(int16_t *const *stems, uint32_t samples);
+
+  // number of calls to render() that have completed
+  uint64_t epoch() const {
+    return _epoch.load();
+  }
+
   void stop();
+  // loop the current pattern
   void play();
+  // play each pattern in the song order list once, then stop when all of
+  // the playing notes have finished
+  void play_song();
+
+  // true while the player is producing audio
+  bool playing() const {
+    return _playing;
+  }
 
   void set_pattern(uint32_t index);
 
   // play a new note immediately
   void play_note(const note_t &n);
 
+  // render only the notes started by play_note(), whether or not the
+  // player is playing. this is for a player kept for live input which
+  // never plays patterns, so it can be rendered at the last moment.
+  void render_notes(int16_t *out, uint32_t samples);
+
   // return the player mutex
   std::mutex &mutex() {
     return _mutex;
@@ -165,6 +350,8 @@ struct player_t {
 
 protected:
   friend struct playing_note_t;
+  // drives the player one pattern at a time from a saved voice state
+  friend struct render_cache_t;
 
   // find the next note
   // if n==nullptr return the first note in a pattern
@@ -173,18 +360,28 @@ protected:
 
   // reached a note
   void _on_note(const note_t *note);
+  // start a note on a free voice
+  void _start_note(const note_t &note);
   // end of pattern
   void _on_pattern_end();
 
   // try to render the requested number of samples but return
   // the number actually rendered
   uint32_t _render_samples(int16_t *out, uint32_t samples);
+  // as above with each voice mixed into outs[instrument]
+  uint32_t _render_samples(int16_t *const *outs, uint32_t samples);
 
   const song_t &_song;
   const pattern_t *_pattern;
 
   // true if playing, false if not
   bool _playing;
+  // true if following the song order list
+  bool _song_mode;
+  // true once the order list is exhausted and only note tails remain
+  bool _song_end;
+  // current index into the song order list
+  uint32_t _order;
 
   // pattern playback position
   position_t _playback_pos;
@@ -198,5 +395,42 @@ protected:
 
   // render thread mutex
   std::mutex _mutex;
+  // incremented after each render() call
+  std::atomic<uint64_t> _epoch;
+};
+
+// samples that have been replaced while the audio thread may still be
+// reading from them are parked here until the player has completed a full
+// render pass, so that they are never released inside the audio callback
+struct sample_bin_t {
+
+  // park a sample that has just been replaced
+  void retire(const player_t &player, std::shared_ptr<const sample_t> s) {
+    retire({ &player }, std::move(s));
+  }
+
+  // park a sample that any of several players may be reading
+  void retire(std::initializer_list<const player_t *> players, std::shared_ptr<const sample_t> s);
+
+  // release all samples the player can no longer be referencing
+  void collect(const player_t &player) {
+    collect({ &player });
+  }
+
+  // the players must be given in the same order as to retire()
+  void collect(std::initializer_list<const player_t *> players);
+
+  // number of samples waiting to be released
+  size_t size() const;
+
+protected:
+  struct entry_t {
+    // player epochs at the time of retirement
+    std::vector<uint64_t> epochs;
+    std::shared_ptr<const sample_t> sample;
+  };
+
+  mutable std::mutex _mutex;
+  std::vector<entry_t> _entries;
 };
 }  // namespace Tracker
@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+
+/* c interface to Tracker::engine_t
+ *
+ * an engine owns one song and renders it as 16 bit mono audio. engines
+ * share no mutable state so each thread may render its own engine. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tracker_engine_t tracker_engine_t;
+
+/* returns NULL on failure */
+tracker_engine_t *tracker_engine_create(uint32_t sample_rate);
+void tracker_engine_destroy(tracker_engine_t *engine);
+
+/* load a song file and play it from the start, returns non zero on success */
+int tracker_engine_load_song(tracker_engine_t *engine, const char *path);
+
+/* render frames into out, returns frames or zero once the song has ended */
+uint32_t tracker_engine_render(tracker_engine_t *engine, int16_t *out, uint32_t frames);
+
+/* non zero while the song is still producing audio */
+int tracker_engine_playing(const tracker_engine_t *engine);
+
+#ifdef __cplusplus
+}
+#endif
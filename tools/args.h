@@ -0,0 +1,29 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+
+// command line value parsing shared by the tools
+
+enum {
+  ARG_MIN_RATE = 8000,
+  ARG_MAX_RATE = 192000,
+  ARG_MAX_THREADS = 1024,
+};
+
+// parse a decimal value in [min, max], rejecting a sign, trailing text and
+// anything out of range rather than wrapping as atoi() would
+inline bool parse_uint(const char *text, uint32_t min, uint32_t max, uint32_t &out) {
+  // strtoul() would accept leading space and negate a leading '-'
+  if (text[0] < '0' || text[0] > '9') {
+    return false;
+  }
+  errno = 0;
+  char *end = nullptr;
+  const unsigned long long value = strtoull(text, &end, 10);
+  if (errno == ERANGE || *end != '\0' || value < min || value > max) {
+    return false;
+  }
+  out = uint32_t(value);
+  return true;
+}
@@ -0,0 +1,409 @@
+// benchmark the specialised voice render kernels against the generic kernel
+//
+//   kernel_bench [-frames <n>] [-total <n>] [file.wav ...]
+//
+// every sample format, channel count, interpolation and loop mode is run
+// through both kernels, the outputs are checked to be identical and the cost
+// per output sample of each is reported. -frames sets the length of the
+// test samples and -total the output samples rendered for each run.
+//
+// each wave file given is then run through the dsp kernels of every
+// instruction set level this cpu supports, checking that they match the
+// scalar kernels exactly and reporting their cost. finally the files are
+// stored in every sample format to report the memory used, the error
+// against 16 bit storage and the cost of playback.
+//
+// the output resampler is run over common rate pairs with every instruction
+// set level, checking each against scalar and reporting the cost per output
+// frame. the exit code is non zero if any kernel mismatched, so with a
+// small -total this doubles as the dispatch test ctest runs on samples/.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "tracker.h"
+#include "kernels.h"
+#include "codec.h"
+#include "dsp.h"
+#include "bank.h"
+#include "libwav.h"
+#include "resampler.h"
+#include "args.h"
+
+
+namespace {
+
+using namespace Tracker;
+
+typedef std::chrono::steady_clock clock_type;
+
+enum {
+  BLOCK = 512,
+  VOICES = 8,
+};
+
+struct bench_mode_t {
+  sample_format_t format;
+  uint32_t channels;
+  interp_t interp;
+  loop_t loop;
+};
+
+void make_sample(sample_t &s, sample_format_t format, uint32_t channels, uint32_t frames) {
+  std::mt19937 rng{ 1234 };
+  s.format = format;
+  s.channels = channels;
+  s.sample_rate = 44100;
+  s.alloc(frames);
+  // noise is a valid sample in every format
+  for (size_t i = 0; i < s.bytes(); ++i) {
+    s.data[i] = uint8_t(rng());
+  }
+}
+
+// render a number of output samples with a few voices at different pitches
+// restarting voices that finish, returning the time taken in seconds
+template <typename render_t>
+double run(const sample_t &s, uint32_t total, std::vector<int16_t> &out, render_t render) {
+  phase_t phase[VOICES];
+  phase_t step[VOICES];
+  for (uint32_t v = 0; v < VOICES; ++v) {
+    phase[v] = 0;
+    step[v] = phase_t((0.5 + 0.37 * v) * double(1ull << PHASE_BITS));
+  }
+  const uint32_t start = s.size / 4;
+  const uint32_t end = s.size;
+  out.assign(total, 0);
+  const auto t = clock_type::now();
+  for (uint32_t i = 0; i < total; i += BLOCK) {
+    for (uint32_t v = 0; v < VOICES; ++v) {
+      if (render(phase[v], step[v], s, start, end, out.data() + i, BLOCK)) {
+        phase[v] = 0;
+      }
+    }
+  }
+  return std::chrono::duration<double>(clock_type::now() - t).count();
+}
+
+struct dsp_result_t {
+
+  dsp_result_t()
+    : mismatches(0)
+    , samples(0)
+    , seconds(0.0)
+  {
+  }
+
+  uint64_t mismatches;
+  uint64_t samples;
+  double seconds;
+};
+
+enum {
+  OP_MONO_TO_STEREO,
+  OP_U8_TO_S8,
+  OP_NEAREST,
+  OP_LINEAR,
+  NUM_OPS,
+};
+
+// run every dsp op of one level over a sample comparing against scalar
+void check_dsp(const dsp_t &ref, const dsp_t &ops, const std::vector<int16_t> &mono,
+               dsp_result_t *result) {
+  const uint32_t size = uint32_t(mono.size());
+  std::vector<int16_t> a, b;
+  const auto time = [](dsp_result_t &r, uint64_t samples, clock_type::time_point t) {
+    r.seconds += std::chrono::duration<double>(clock_type::now() - t).count();
+    r.samples += samples;
+  };
+  const auto compare = [](dsp_result_t &r, const void *x, const void *y, size_t bytes) {
+    const uint8_t *p = static_cast<const uint8_t *>(x);
+    const uint8_t *q = static_cast<const uint8_t *>(y);
+    for (size_t i = 0; i < bytes; ++i) {
+      r.mismatches += (p[i] != q[i]) ? 1 : 0;
+    }
+  };
+  {
+    a.assign(size * 2, 0);
+    b.assign(size * 2, 0);
+    ref.mono_to_stereo(mono.data(), a.data(), size);
+    const auto t = clock_type::now();
+    ops.mono_to_stereo(mono.data(), b.data(), size);
+    time(result[OP_MONO_TO_STEREO], size, t);
+    compare(result[OP_MONO_TO_STEREO], a.data(), b.data(), a.size() * sizeof(int16_t));
+  }
+  {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(mono.data());
+    const uint32_t count = size * 2;
+    std::vector<int8_t> x(count), y(count);
+    ref.u8_to_s8(bytes, x.data(), count);
+    const auto t = clock_type::now();
+    ops.u8_to_s8(bytes, y.data(), count);
+    time(result[OP_U8_TO_S8], count, t);
+    compare(result[OP_U8_TO_S8], x.data(), y.data(), x.size());
+  }
+  if (size < 2) {
+    return;
+  }
+  static const double steps[] = { 0.25, 0.5, 1.0, 1.37, 2.9 };
+  for (double s : steps) {
+    const phase_t step = phase_t(s * double(1ull << PHASE_BITS));
+    // the resample kernels may read one frame past the one being played
+    const phase_t limit = phase_t(size - 1) << PHASE_BITS;
+    const uint32_t count = uint32_t((limit + step - 1) / step);
+    for (int op = OP_NEAREST; op <= OP_LINEAR; ++op) {
+      const auto fn_ref = (op == OP_NEAREST) ? ref.resample_nearest : ref.resample_linear;
+      const auto fn = (op == OP_NEAREST) ? ops.resample_nearest : ops.resample_linear;
+      a.assign(count, 0);
+      b.assign(count, 0);
+      const phase_t pa = fn_ref(mono.data(), 0, step, a.data(), count);
+      const auto t = clock_type::now();
+      const phase_t pb = fn(mono.data(), 0, step, b.data(), count);
+      time(result[op], count, t);
+      compare(result[op], a.data(), b.data(), a.size() * sizeof(int16_t));
+      result[op].mismatches += (pa != pb) ? 1 : 0;
+    }
+  }
+}
+
+// check every supported dsp level against scalar on a set of wave files
+bool bench_dsp(const std::vector<const char *> &files) {
+  std::vector<std::vector<int16_t>> samples;
+  for (const char *path : files) {
+    wave_t wave;
+    if (!wave.load(path)) {
+      fprintf(stderr, "unable to load '%s'\n", path);
+      return false;
+    }
+    auto s = sample_from_wave(wave);
+    std::vector<int16_t> mono(s->size);
+    for (uint32_t i = 0; i < s->size; ++i) {
+      mono[i] = s->frame(i);
+    }
+    samples.push_back(std::move(mono));
+  }
+
+  static const char *op_names[] = { "mono_to_stereo", "u8_to_s8", "nearest", "linear" };
+
+  printf("\n%u files, detected level %s, active level %s\n",
+    uint32_t(files.size()), dsp_level_name(dsp_detect()), dsp_level_name(dsp().level));
+  printf("%-8s %-16s %12s %12s\n", "level", "op", "mismatches", "ns/sample");
+
+  dsp_t ref;
+  dsp_bind(DSP_SCALAR, ref);
+  bool ok = true;
+  for (int l = 0; l < NUM_DSP_LEVELS; ++l) {
+    dsp_t ops;
+    if (!dsp_bind(dsp_level_t(l), ops)) {
+      printf("%-8s unsupported\n", dsp_level_name(dsp_level_t(l)));
+      continue;
+    }
+    dsp_result_t result[NUM_OPS];
+    for (const auto &mono : samples) {
+      check_dsp(ref, ops, mono, result);
+    }
+    for (int op = 0; op < NUM_OPS; ++op) {
+      const dsp_result_t &r = result[op];
+      ok &= (r.mismatches == 0);
+      printf("%-8s %-16s %12llu %12.3f\n", dsp_level_name(dsp_level_t(l)), op_names[op],
+        (unsigned long long)r.mismatches, r.samples ? (r.seconds * 1e9 / double(r.samples)) : 0.0);
+    }
+  }
+  return ok;
+}
+
+// store each wave file in every format reporting size, error and speed
+void bench_codec(const std::vector<const char *> &files, uint32_t total) {
+  std::vector<std::shared_ptr<sample_t>> sources;
+  for (const char *path : files) {
+    auto s = sample_load(path);
+    if (s) {
+      // measure against the 16 bit version of every file
+      sources.push_back(sample_encode(*s, SAMPLE_S16));
+    }
+  }
+
+  printf("\n%-6s %12s %8s %10s %12s\n", "format", "bytes", "ratio", "snr(db)", "ns/sample");
+  for (uint32_t f = 0; f < NUM_SAMPLE_FORMATS; ++f) {
+    size_t bytes = 0, raw = 0;
+    double signal = 0.0, noise = 0.0, seconds = 0.0;
+    uint64_t rendered = 0;
+    std::vector<int16_t> a, b, out;
+    for (const auto &src : sources) {
+      auto s = sample_encode(*src, sample_format_t(f));
+      bytes += s->bytes();
+      raw += src->bytes();
+      sample_decode(*src, a);
+      sample_decode(*s, b);
+      for (size_t i = 0; i < a.size(); ++i) {
+        const double d = double(a[i]) - double(b[i]);
+        signal += double(a[i]) * double(a[i]);
+        noise += d * d;
+      }
+      if (s->size < 2) {
+        continue;
+      }
+      const bench_mode_t m = { s->format, s->channels, INTERP_LINEAR, LOOP_FORWARD };
+      // run() renders whole blocks
+      const uint32_t count = std::max<uint32_t>(total / uint32_t(sources.size()) / BLOCK, 1) * BLOCK;
+      seconds += run(*s, count, out, select_kernel(m.format, m.channels, m.interp, m.loop));
+      rendered += uint64_t(count) * VOICES;
+    }
+    const double snr = (noise > 0.0) ? 10.0 * log10(signal / noise) : INFINITY;
+    printf("%-6s %12llu %7.2fx %10.1f %12.3f\n",
+      sample_format_name(sample_format_t(f)), (unsigned long long)bytes,
+      bytes ? double(raw) / double(bytes) : 0.0, snr,
+      rendered ? seconds * 1e9 / double(rendered) : 0.0);
+  }
+}
+
+// a falling sweep plus some noise so every filter phase sees a varied signal
+void make_signal(std::vector<int16_t> &out, uint32_t rate, uint32_t frames) {
+  std::mt19937 rng{ 1234 };
+  out.resize(frames);
+  for (uint32_t i = 0; i < frames; ++i) {
+    const double t = double(i) / double(rate);
+    const double f = 4000.0 / (1.0 + t);
+    const double noise = double(int32_t(rng() & 0x3ff) - 0x200);
+    out[i] = int16_t(12000.0 * sin(2.0 * 3.14159265358979 * f * t) + noise);
+  }
+}
+
+// convert a test signal between common rates at every dsp level
+bool bench_resampler(uint32_t total) {
+  static const uint32_t rates[][2] = {
+    { 44100, 48000 },
+    { 48000, 44100 },
+    { 96000, 44100 },
+    { 96000, 48000 },
+    { 22050, 44100 },
+    { 44100, 96000 },
+  };
+
+  printf("\n%-8s %-14s %12s %12s\n", "level", "rates", "mismatches", "ns/frame");
+
+  bool ok = true;
+  for (const auto &r : rates) {
+    std::vector<int16_t> ref;
+    for (int l = 0; l < NUM_DSP_LEVELS; ++l) {
+      dsp_t ops;
+      if (!dsp_bind(dsp_level_t(l), ops)) {
+        continue;
+      }
+      resampler_t resampler;
+      if (!resampler.init(r[0], r[1], ops)) {
+        printf("%-8s %6u>%-7u unsupported\n", dsp_level_name(dsp_level_t(l)), r[0], r[1]);
+        ok = false;
+        break;
+      }
+      // generate the input up front so only the resampler is timed
+      const uint64_t in_frames = uint64_t(total) * r[0] / r[1] + resampler_t::TAPS + resampler_t::CHUNK;
+      std::vector<int16_t> input;
+      make_signal(input, r[0], uint32_t(in_frames));
+      size_t read = 0;
+      std::vector<int16_t> out(total);
+      const auto t = clock_type::now();
+      for (uint32_t i = 0; i < total; i += BLOCK) {
+        resampler.pull(out.data() + i, std::min<uint32_t>(BLOCK, total - i),
+          [&input, &read](int16_t *in, uint32_t frames) {
+            memcpy(in, input.data() + read, frames * sizeof(int16_t));
+            read += frames;
+          });
+      }
+      const double seconds = std::chrono::duration<double>(clock_type::now() - t).count();
+      if (l == DSP_SCALAR) {
+        ref = out;
+      }
+      uint64_t mismatches = 0;
+      for (size_t i = 0; i < out.size(); ++i) {
+        mismatches += (out[i] != ref[i]) ? 1 : 0;
+      }
+      ok &= (mismatches == 0);
+      printf("%-8s %6u>%-7u %12llu %12.3f\n", dsp_level_name(dsp_level_t(l)), r[0], r[1],
+        (unsigned long long)mismatches, seconds * 1e9 / double(total));
+    }
+  }
+  return ok;
+}
+
+int usage() {
+  fprintf(stderr, "usage: kernel_bench [-frames <n>] [-total <n>] [file.wav ...]\n");
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char **args) {
+  uint32_t frames = 1 << 16;
+  uint32_t total = 1 << 22;
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = (i + 1) < argc;
+    if (strcmp(args[i], "-frames") == 0 && has_value) {
+      if (!parse_uint(args[++i], 2, 1u << 24, frames)) {
+        return usage();
+      }
+    }
+    else if (strcmp(args[i], "-total") == 0 && has_value) {
+      if (!parse_uint(args[++i], BLOCK, 1u << 28, total)) {
+        return usage();
+      }
+      // run() renders whole blocks
+      total -= total % BLOCK;
+    }
+    else if (args[i][0] == '-') {
+      return usage();
+    }
+    else {
+      files.push_back(args[i]);
+    }
+  }
+
+  static const char *interp_names[] = { "nearest", "linear" };
+  static const char *loop_names[] = { "none", "forward" };
+
+  printf("%-6s %-3s %-8s %-8s %14s %14s %8s\n",
+    "format", "ch", "interp", "loop", "generic(ns)", "special(ns)", "speedup");
+
+  bool ok = true;
+  std::vector<int16_t> ref, out;
+  for (uint32_t f = 0; f < NUM_SAMPLE_FORMATS; ++f) {
+    for (uint32_t c = 1; c <= 2; ++c) {
+      sample_t s;
+      make_sample(s, sample_format_t(f), c, frames);
+      for (uint32_t in = 0; in < NUM_INTERP; ++in) {
+        for (uint32_t l = 0; l < NUM_LOOP; ++l) {
+          const bench_mode_t m = { sample_format_t(f), c, interp_t(in), loop_t(l) };
+
+          const double generic = run(s, total, ref,
+            [&m](phase_t &phase, phase_t step, const sample_t &s, uint32_t start,
+                 uint32_t end, int16_t *out, uint32_t n) {
+              return render_generic(m.interp, m.loop, phase, step, s, start, end, out, n);
+            });
+
+          const kernel_t kernel = select_kernel(m.format, m.channels, m.interp, m.loop);
+          const double special = run(s, total, out, kernel);
+
+          const bool same = (ref == out);
+          ok &= same;
+          const double scale = 1e9 / (double(total) * VOICES);
+          printf("%-6s %-3u %-8s %-8s %14.3f %14.3f %7.2fx%s\n",
+            sample_format_name(sample_format_t(f)), c, interp_names[in], loop_names[l],
+            generic * scale, special * scale, generic / special,
+            same ? "" : "  MISMATCH");
+        }
+      }
+    }
+  }
+  if (!files.empty()) {
+    ok &= bench_dsp(files);
+    bench_codec(files, total);
+  }
+  ok &= bench_resampler(total / 8);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,484 @@
+// golden render and render time check for the player
+//
+//   render_check [-samples <dir>] [-golden <file>] [-update]
+//
+// a few fixed songs are built from the bundled samples and rendered through
+// player_t. each render is compared with the golden file, first by hash and
+// failing that by its loudness envelope within a tolerance, so a silent or
+// broken mixer is caught while tiny numerical changes are only reported.
+// every song must also render at least as fast as its realtime budget.
+// -update rewrites the golden file from the current renders.
+//
+// each song is then rendered through render_cache_t, which must match the
+// player rendering the song in one block, reuse every pattern on a second
+// pass and after one note is changed give exactly what an empty cache gives.
+// playing the song again after that edit must also render less than
+// CACHE_FRACTION of its frames rather than taking them from the cache. the
+// time that takes against the player is only reported, as a render that
+// takes well under a millisecond is too noisy to fail on.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "tracker.h"
+#include "libwav.h"
+#include "bank.h"
+#include "render_cache.h"
+
+
+namespace {
+
+using namespace Tracker;
+
+typedef std::chrono::steady_clock clock_type;
+
+enum {
+  // frames per envelope window, 100ms
+  ENV_WINDOW = 4410,
+  RATE = 44100,
+  // renders are timed this many times taking the fastest
+  TIMING_RUNS = 3,
+};
+
+// default minimum render speed in multiples of realtime
+const double DEFAULT_BUDGET = 50.0;
+
+// most of a song's frames an edit may have rendered again through the cache
+const double CACHE_FRACTION = 0.75;
+
+struct render_t {
+  std::string name;
+  uint64_t frames;
+  uint64_t hash;
+  double realtime;
+  std::vector<uint32_t> env;
+};
+
+struct golden_t {
+  std::string name;
+  uint64_t frames;
+  uint64_t hash;
+  double budget;
+  std::vector<uint32_t> env;
+};
+
+struct song_def_t {
+  const char *name;
+  bool (*build)(song_t &song, const std::string &dir);
+};
+
+bool set_sample(song_t &song, uint32_t index, const std::string &dir, const char *name) {
+  wave_t wave;
+  if (!wave.load((dir + name).c_str())) {
+    fprintf(stderr, "unable to load '%s%s'\n", dir.c_str(), name);
+    return false;
+  }
+  auto &ins = song.instruments[index];
+  auto sample = sample_from_wave(wave);
+  ins.sample_start = 0;
+  ins.sample_end = sample->size;
+  ins.set_sample(std::move(sample));
+  return true;
+}
+
+void set_orders(song_t &song, std::initializer_list<uint8_t> orders) {
+  song.orders_head = 0;
+  for (uint8_t o : orders) {
+    song.orders[song.orders_head++] = o;
+  }
+}
+
+// kick, snare and hats across two patterns
+bool song_drums(song_t &song, const std::string &dir) {
+  song.bpm = 120;
+  if (!set_sample(song, 0, dir, "BassDrum1.wav") ||
+      !set_sample(song, 1, dir, "Snare1.wav") ||
+      !set_sample(song, 2, dir, "HiHat1.wav")) {
+    return false;
+  }
+  for (uint32_t p = 0; p < 2; ++p) {
+    auto &pat = song.patterns[p];
+    for (uint32_t b = 0; b < BEATS_IN_PATTERN; ++b) {
+      pat.note_insert(note_t{ float(b), uint8_t((b & 1) ? 69 : 57), uint8_t(b & 1) });
+      pat.note_insert(note_t{ float(b) + .5f, 81, 2 });
+      if (p == 1 && (b % 4) == 3) {
+        pat.note_insert(note_t{ float(b) + .75f, 69, 1 });
+      }
+    }
+  }
+  set_orders(song, { 0, 1, 0, 1 });
+  return true;
+}
+
+// arpeggios with linear interpolation over a bass line
+bool song_melody(song_t &song, const std::string &dir) {
+  song.bpm = 100;
+  if (!set_sample(song, 0, dir, "Marimba.wav") ||
+      !set_sample(song, 1, dir, "DXBass.wav")) {
+    return false;
+  }
+  song.instruments[0].interp = INTERP_LINEAR;
+  song.instruments[1].root = 57;
+  static const uint8_t chords[2][4] = { { 60, 64, 67, 72 }, { 57, 60, 64, 69 } };
+  for (uint32_t p = 0; p < 2; ++p) {
+    auto &pat = song.patterns[p];
+    for (uint32_t i = 0; i < BEATS_IN_PATTERN * 2; ++i) {
+      const uint8_t *chord = chords[(p + i / 16) & 1];
+      pat.note_insert(note_t{ float(i) * .5f, chord[i & 3], 0 });
+    }
+    for (uint32_t b = 0; b < BEATS_IN_PATTERN; b += 2) {
+      pat.note_insert(note_t{ float(b), uint8_t(45 + ((b / 4) & 1) * 5), 1 });
+    }
+  }
+  set_orders(song, { 0, 1 });
+  return true;
+}
+
+// looping instruments cut by each following note
+bool song_loops(song_t &song, const std::string &dir) {
+  song.bpm = 140;
+  if (!set_sample(song, 0, dir, "RichString.wav") ||
+      !set_sample(song, 1, dir, "Organ.wav") ||
+      !set_sample(song, 2, dir, "Koto.wav")) {
+    return false;
+  }
+  for (uint32_t i = 0; i < 3; ++i) {
+    auto &ins = song.instruments[i];
+    ins.loop = LOOP_FORWARD;
+    ins.interp = INTERP_LINEAR;
+    ins.sample_start = ins.sample_end / 2;
+  }
+  auto &pat = song.patterns[0];
+  static const uint8_t roots[] = { 60, 65, 67, 62 };
+  for (uint32_t b = 0; b < BEATS_IN_PATTERN; b += 4) {
+    const uint8_t r = roots[b / 4];
+    pat.note_insert(note_t{ float(b), r, 0 });
+    pat.note_insert(note_t{ float(b), uint8_t(r + 4), 1 });
+    pat.note_insert(note_t{ float(b) + 2.f, uint8_t(r + 7), 2 });
+  }
+  set_orders(song, { 0, 0 });
+  return true;
+}
+
+// every voice busy with a different instrument, used for the speed budget
+bool song_dense(song_t &song, const std::string &dir) {
+  song.bpm = 180;
+  static const char *names[] = {
+    "RichString.wav", "Organ.wav", "Koto.wav", "Marimba.wav",
+    "DXBass.wav", "KorgString.wav", "Heaven.wav", "PolySynth.wav",
+  };
+  for (uint32_t i = 0; i < 8; ++i) {
+    if (!set_sample(song, i, dir, names[i])) {
+      return false;
+    }
+    song.instruments[i].interp = (i & 1) ? INTERP_LINEAR : INTERP_NEAREST;
+  }
+  for (uint32_t p = 0; p < 4; ++p) {
+    auto &pat = song.patterns[p];
+    for (uint32_t i = 0; i < BEATS_IN_PATTERN * 4; ++i) {
+      const uint8_t note = uint8_t(48 + ((i * 7 + p * 5) % 36));
+      pat.note_insert(note_t{ float(i) * .25f, note, uint8_t((i + p) & 7) });
+    }
+  }
+  set_orders(song, { 0, 1, 2, 3, 0, 1, 2, 3 });
+  return true;
+}
+
+const song_def_t songs[] = {
+  { "drums", song_drums },
+  { "melody", song_melody },
+  { "loops", song_loops },
+  { "dense", song_dense },
+};
+
+uint64_t fnv1a(const int16_t *data, size_t count) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < count * sizeof(int16_t); ++i) {
+    h = (h ^ p[i]) * 0x100000001b3ull;
+  }
+  return h;
+}
+
+// render a whole song returning the audio, rendering straight into audio
+// so that reusing it keeps copies out of the timings
+void render_song(const song_t &song, std::vector<int16_t> &audio, uint32_t block = 1024) {
+  audio.clear();
+  player_t player{ song, RATE };
+  player.play_song();
+  while (player.playing()) {
+    const size_t done = audio.size();
+    audio.resize(done + block);
+    player.render(audio.data() + done, block);
+  }
+}
+
+// true if a and b match up to the shorter length and the rest is silent
+bool same_audio(const std::vector<int16_t> &a, const std::vector<int16_t> &b) {
+  const std::vector<int16_t> &longer = (a.size() > b.size()) ? a : b;
+  const size_t common = std::min(a.size(), b.size());
+  return std::equal(a.begin(), a.begin() + common, b.begin()) &&
+    std::all_of(longer.begin() + common, longer.end(), [](int16_t v) { return v == 0; });
+}
+
+// render a whole song through a render cache
+void render_cached(render_cache_t &cache, const song_t &song, std::vector<int16_t> &audio) {
+  audio.clear();
+  cache.start(song, RATE);
+  while (cache.playing()) {
+    const size_t done = audio.size();
+    audio.resize(done + 1024);
+    cache.render(audio.data() + done, 1024);
+  }
+}
+
+// check the render cache against the player and against itself
+bool check_cache(const song_def_t &def, const std::string &dir) {
+  std::unique_ptr<song_t> song{ new song_t };
+  if (!def.build(*song, dir)) {
+    return false;
+  }
+  std::vector<int16_t> played, first, second, edited, fresh;
+  // a block long enough for any of the songs
+  render_song(*song, played, 1 << 22);
+  // the time the player takes without a cache
+  double full_s = 1e9;
+  for (int i = 0; i < TIMING_RUNS; ++i) {
+    const auto t = clock_type::now();
+    render_song(*song, fresh);
+    full_s = std::min(full_s, std::chrono::duration<double>(clock_type::now() - t).count());
+  }
+  render_cache_t cache;
+  render_cached(cache, *song, first);
+  const uint32_t first_misses = cache.misses();
+  render_cached(cache, *song, second);
+  const bool reused = (cache.misses() == 0) && (cache.tails() == 0) && (first == second);
+
+  // move the last note of the pattern played last up a semitone each run,
+  // a new note every time so the pattern is never already cached
+  pattern_t &pat = song->patterns[song->orders[song->orders_head - 1]];
+  double edit_s = 1e9;
+  uint32_t edit_misses = 0, edit_tails = 0;
+  uint64_t edit_frames = 0;
+  bool exact_edit = true;
+  for (int i = 0; i < TIMING_RUNS; ++i) {
+    note_t n = pat.notes[pat.notes_head - 1];
+    pat.note_remove(n);
+    n.note += 1;
+    pat.note_insert(n);
+    const auto t = clock_type::now();
+    render_cached(cache, *song, edited);
+    edit_s = std::min(edit_s, std::chrono::duration<double>(clock_type::now() - t).count());
+    edit_misses = cache.misses();
+    edit_tails = cache.tails();
+    edit_frames = std::max(edit_frames, cache.rendered());
+    render_cache_t empty;
+    render_cached(empty, *song, fresh);
+    exact_edit &= (edited == fresh);
+  }
+
+  const bool same_sound = same_audio(first, played);
+  const double work = double(edit_frames) / double(std::max<size_t>(first.size(), 1));
+  const bool fast = work < CACHE_FRACTION;
+  const bool ok = same_sound && reused && exact_edit && fast;
+  printf("%-8s %8u %8u %8u %8u %7.0f%% %9.1fx %-8s\n", def.name, uint32_t(song->orders_head),
+    first_misses, edit_misses, edit_tails, work * 100.0, full_s / std::max(edit_s, 1e-9),
+    ok ? "ok" : !same_sound ? "differs" : !reused ? "no reuse" : !exact_edit ? "stale" : "slow");
+  return ok;
+}
+
+bool render(const song_def_t &def, const std::string &dir, render_t &out) {
+  std::unique_ptr<song_t> song{ new song_t };
+  if (!def.build(*song, dir)) {
+    return false;
+  }
+  std::vector<int16_t> audio;
+  double best = 1e9;
+  for (int i = 0; i < TIMING_RUNS; ++i) {
+    const auto t = clock_type::now();
+    render_song(*song, audio);
+    best = std::min(best, std::chrono::duration<double>(clock_type::now() - t).count());
+  }
+  out.name = def.name;
+  out.frames = audio.size();
+  out.hash = fnv1a(audio.data(), audio.size());
+  out.realtime = (double(audio.size()) / RATE) / std::max(best, 1e-9);
+  out.env.clear();
+  for (size_t i = 0; i < audio.size(); i += ENV_WINDOW) {
+    const size_t end = std::min(audio.size(), i + ENV_WINDOW);
+    double sum = 0.0;
+    for (size_t j = i; j < end; ++j) {
+      sum += double(audio[j]) * double(audio[j]);
+    }
+    out.env.push_back(uint32_t(std::sqrt(sum / double(end - i)) + .5));
+  }
+  return true;
+}
+
+// golden file format, one song per line:
+//   <name> <frames> <hash> <budget> <env> <env> ...
+bool load_golden(const char *path, std::vector<golden_t> &out) {
+  FILE *fd = fopen(path, "r");
+  if (!fd) {
+    return false;
+  }
+  char name[64];
+  unsigned long long frames, hash;
+  double budget;
+  while (fscanf(fd, "%63s %llu %llx %lf", name, &frames, &hash, &budget) == 4) {
+    golden_t g;
+    g.name = name;
+    g.frames = frames;
+    g.hash = hash;
+    g.budget = budget;
+    unsigned v;
+    while (fscanf(fd, "%u", &v) == 1) {
+      g.env.push_back(v);
+    }
+    out.push_back(std::move(g));
+  }
+  fclose(fd);
+  return true;
+}
+
+bool save_golden(const char *path, const std::vector<render_t> &renders,
+                 const std::vector<golden_t> &old) {
+  FILE *fd = fopen(path, "w");
+  if (!fd) {
+    return false;
+  }
+  for (const auto &r : renders) {
+    // keep any budget that was tuned by hand
+    double budget = DEFAULT_BUDGET;
+    for (const auto &g : old) {
+      if (g.name == r.name) {
+        budget = g.budget;
+      }
+    }
+    fprintf(fd, "%s %llu %016llx %.1f", r.name.c_str(), (unsigned long long)r.frames,
+      (unsigned long long)r.hash, budget);
+    for (uint32_t v : r.env) {
+      fprintf(fd, " %u", v);
+    }
+    fprintf(fd, "\n");
+  }
+  fclose(fd);
+  return true;
+}
+
+// true if each envelope window is within 2% (or a small absolute amount)
+bool env_close(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    const double tol = std::max(4.0, double(b[i]) * 0.02);
+    if (std::fabs(double(a[i]) - double(b[i])) > tol) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **args) {
+  std::string dir = "samples/";
+  std::string golden_path = "tools/render_check.golden";
+  bool update = false;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = (i + 1) < argc;
+    if (strcmp(args[i], "-samples") == 0 && has_value) {
+      dir = args[++i];
+      if (!dir.empty() && dir.back() != '/' && dir.back() != '\\') {
+        dir += '/';
+      }
+    }
+    else if (strcmp(args[i], "-golden") == 0 && has_value) {
+      golden_path = args[++i];
+    }
+    else if (strcmp(args[i], "-update") == 0) {
+      update = true;
+    }
+    else {
+      fprintf(stderr, "usage: render_check [-samples <dir>] [-golden <file>] [-update]\n");
+      return 1;
+    }
+  }
+
+  std::vector<golden_t> golden;
+  if (!load_golden(golden_path.c_str(), golden) && !update) {
+    fprintf(stderr, "unable to load golden file '%s'\n", golden_path.c_str());
+    return 1;
+  }
+
+  std::vector<render_t> renders;
+  for (const auto &def : songs) {
+    render_t r;
+    if (!render(def, dir, r)) {
+      return 1;
+    }
+    renders.push_back(std::move(r));
+  }
+
+  if (update) {
+    if (!save_golden(golden_path.c_str(), renders, golden)) {
+      fprintf(stderr, "unable to write golden file '%s'\n", golden_path.c_str());
+      return 1;
+    }
+    printf("updated '%s'\n", golden_path.c_str());
+    return 0;
+  }
+
+  uint32_t failed = 0;
+  printf("%-8s %10s %-16s %-8s %10s %8s\n", "song", "frames", "hash", "result", "realtime", "budget");
+  for (const auto &r : renders) {
+    const golden_t *g = nullptr;
+    for (const auto &x : golden) {
+      if (x.name == r.name) {
+        g = &x;
+      }
+    }
+    const char *result = "missing";
+    bool ok = false;
+    if (g) {
+      if (g->frames == r.frames && g->hash == r.hash) {
+        result = "exact";
+        ok = true;
+      }
+      else if (g->frames == r.frames && env_close(r.env, g->env)) {
+        // small numerical change, audible output is the same
+        result = "close";
+        ok = true;
+      }
+      else {
+        result = "differs";
+      }
+      if (ok && r.realtime < g->budget) {
+        result = "slow";
+        ok = false;
+      }
+    }
+    printf("%-8s %10llu %016llx %-8s %9.1fx %7.1fx\n", r.name.c_str(),
+      (unsigned long long)r.frames, (unsigned long long)r.hash, result,
+      r.realtime, g ? g->budget : 0.0);
+    failed += ok ? 0 : 1;
+  }
+  printf("%u of %u songs failed\n", failed, uint32_t(renders.size()));
+
+  uint32_t cache_failed = 0;
+  printf("\n%-8s %8s %8s %8s %8s %8s %10s %-8s\n", "song", "orders", "rendered", "edited", "tails",
+    "work", "speedup", "cache");
+  for (const auto &def : songs) {
+    cache_failed += check_cache(def, dir) ? 0 : 1;
+  }
+  printf("%u of %u cache checks failed\n", cache_failed, uint32_t(renders.size()));
+  return (failed || cache_failed) ? 1 : 0;
+}
@@ -0,0 +1,524 @@
+// headless render server listening on a unix domain socket
+//
+//   render_daemon -socket <path> [-bank <bank.txt>] [-j <threads>]
+//                 [-queue <jobs>] [-cache <mb>]
+//
+// each connection sends one request line and gets one reply:
+//   render <song.txt|file.mid> <out.wav|-> [<rate> [s16|s24|f32]]
+//     plays the song order list once. with an output path the wave is
+//     written there and the reply is "ok <frames> <wait ms> <render ms>".
+//     with - the reply is "ok" followed by the wave, streamed as it is
+//     rendered until the connection closes.
+//   stats
+//     "queue <waiting> <running> jobs <done> <failed> <rejected>
+//      latency <mean ms> <max ms> samples <count> <bytes>"
+// anything else, or a job that fails, is answered with "error <message>".
+//
+// connections are read without blocking until their request line arrives,
+// and dropped if it takes longer than five seconds. jobs run on a pool of
+// -j workers and requests arriving while -queue jobs are already waiting
+// are turned away with "error busy". samples are loaded through one sample
+// pool shared by every job, so each file is read once while it stays within
+// the -cache budget however many songs use it.
+// midi files are imported with the -bank given at startup. paths may not
+// contain spaces. each job is logged to stdout with its timings.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "libwav.h"
+#include "bank.h"
+#include "sample_pool.h"
+#include "thread_pool.h"
+#include "args.h"
+
+
+namespace {
+
+using namespace Tracker;
+
+typedef std::chrono::steady_clock clock_type;
+
+double ms_since(clock_type::time_point t) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - t).count();
+}
+
+enum {
+  // longest request line accepted
+  MAX_REQUEST = 4096,
+  // seconds a client has to send its request
+  REQUEST_TIMEOUT = 5,
+  // most connections waiting to send their request
+  MAX_PENDING = 256,
+  // milliseconds between checks for a signal to quit
+  POLL_INTERVAL = 250,
+  MAX_QUEUE = 1 << 16,
+  MAX_CACHE_MB = 1 << 20,
+  // frames rendered at a time
+  BLOCK = 4096,
+};
+
+struct options_t {
+
+  options_t()
+    : threads(std::max(std::thread::hardware_concurrency(), 1u))
+    , queue(64)
+    , cache_mb(512)
+    , max_seconds(60 * 60)
+  {
+  }
+
+  std::string socket;
+  std::string bank;
+  uint32_t threads;
+  // most jobs waiting for a worker
+  uint32_t queue;
+  // sample pool budget
+  uint32_t cache_mb;
+  // longest render allowed for a single job
+  uint32_t max_seconds;
+};
+
+struct request_t {
+
+  request_t()
+    : rate(44100)
+    , type(WAVE_PCM16)
+  {
+  }
+
+  std::string song;
+  // output path or "-" to stream the wave back
+  std::string output;
+  uint32_t rate;
+  wave_sample_t type;
+};
+
+// counters shared between the listener and the workers
+struct stats_t {
+
+  stats_t()
+    : waiting(0)
+    , running(0)
+    , done(0)
+    , failed(0)
+    , rejected(0)
+    , total_ms(0.0)
+    , max_ms(0.0)
+  {
+  }
+
+  // record a finished job and its time from accept to reply
+  void finish(bool ok, double ms) {
+    std::lock_guard<std::mutex> guard{ mutex };
+    --running;
+    if (!ok) {
+      ++failed;
+      return;
+    }
+    ++done;
+    total_ms += ms;
+    max_ms = std::max(max_ms, ms);
+  }
+
+  std::mutex mutex;
+  uint32_t waiting;
+  uint32_t running;
+  uint64_t done;
+  uint64_t failed;
+  uint64_t rejected;
+  double total_ms;
+  double max_ms;
+};
+
+volatile sig_atomic_t _quit = 0;
+
+void on_signal(int) {
+  _quit = 1;
+}
+
+bool send_all(int fd, const char *data, size_t size) {
+  while (size) {
+    const ssize_t n = send(fd, data, size, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= size_t(n);
+  }
+  return true;
+}
+
+bool reply(int fd, const std::string &line) {
+  return send_all(fd, (line + "\n").c_str(), line.size() + 1);
+}
+
+// a connection that has not sent its whole request line yet
+struct pending_t {
+  int fd;
+  clock_type::time_point accepted;
+  std::string line;
+};
+
+enum read_t {
+  READ_MORE,
+  READ_LINE,
+  READ_FAILED,
+};
+
+// read whatever has arrived without waiting, up to the first newline
+read_t read_pending(pending_t &p) {
+  char buffer[512];
+  const ssize_t n = recv(p.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+  if (n < 0) {
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? READ_MORE : READ_FAILED;
+  }
+  if (n == 0) {
+    // the client sent its request without a newline and hung up its side
+    return p.line.empty() ? READ_FAILED : READ_LINE;
+  }
+  for (ssize_t i = 0; i < n; ++i) {
+    if (buffer[i] == '\n') {
+      return READ_LINE;
+    }
+    if (buffer[i] != '\r') {
+      p.line += buffer[i];
+    }
+  }
+  return (p.line.size() < MAX_REQUEST) ? READ_MORE : READ_FAILED;
+}
+
+bool parse_request(const std::string &line, request_t &req) {
+  char song[MAX_REQUEST], output[MAX_REQUEST], format[8] = "s16";
+  uint32_t rate = req.rate;
+  const int n = sscanf(line.c_str(), "render %4095s %4095s %u %7s", song, output, &rate, format);
+  if (n < 2) {
+    return false;
+  }
+  req.song = song;
+  req.output = output;
+  req.rate = rate;
+  if (!wave_sample_parse(format, req.type)) {
+    return false;
+  }
+  return req.rate >= ARG_MIN_RATE && req.rate <= ARG_MAX_RATE;
+}
+
+struct server_t {
+
+  explicit server_t(const options_t &opt)
+    : opt(opt)
+    , pool(size_t(opt.cache_mb) << 20)
+    , has_bank(false)
+  {
+  }
+
+  // render one job, returning the error or nullptr on success. started is
+  // set once a streamed wave has begun and no other reply can be sent.
+  const char *render(int fd, const request_t &req, bool &started, uint64_t &frames,
+                     double &render_ms) {
+    engine_t engine{ req.rate };
+    if (is_midi(req.song.c_str())) {
+      smf_info_t info;
+      if (!has_bank) {
+        return "no bank loaded";
+      }
+      if (!engine.load_midi(req.song.c_str(), bank, info)) {
+        return "unable to parse midi file";
+      }
+    }
+    else {
+      sample_pool_t *p = &pool;
+      const sample_loader_t loader = [p](const std::string &path) { return p->get(path); };
+      if (!engine.load_song(req.song.c_str(), loader)) {
+        return "unable to load song";
+      }
+    }
+
+    const bool stream = (req.output == "-");
+    wave_writer_t wave;
+    FILE *out = nullptr;
+    if (stream) {
+      // the stream owns a duplicate so closing it leaves the socket open
+      out = fdopen(dup(fd), "wb");
+      if (!out) {
+        return "unable to stream wave";
+      }
+      started = true;
+      if (!reply(fd, "ok") || !wave.open(out, 1, req.rate, req.type)) {
+        fclose(out);
+        return "unable to stream wave";
+      }
+    }
+    else if (!wave.open(req.output.c_str(), 1, req.rate, req.type)) {
+      return "unable to create wave";
+    }
+
+    const auto t = clock_type::now();
+    engine.play();
+    const uint64_t max_frames = uint64_t(req.rate) * opt.max_seconds;
+    std::array<int16_t, BLOCK> temp;
+    bool ok = true;
+    while (ok && wave.frames() < max_frames) {
+      const uint32_t done = engine.render(temp.data(), uint32_t(temp.size()));
+      if (!done) {
+        break;
+      }
+      ok = wave.write(temp.data(), done);
+    }
+    frames = wave.frames();
+    ok = wave.close() && ok;
+    render_ms = ms_since(t);
+    if (out) {
+      fclose(out);
+    }
+    return ok ? nullptr : "unable to write wave";
+  }
+
+  // run a queued job on a worker and close its connection
+  void run(int fd, const request_t &req, clock_type::time_point accepted) {
+    double wait_ms = 0.0;
+    {
+      std::lock_guard<std::mutex> guard{ stats.mutex };
+      --stats.waiting;
+      ++stats.running;
+      wait_ms = ms_since(accepted);
+    }
+    bool started = false;
+    uint64_t frames = 0;
+    double render_ms = 0.0;
+    const char *error = render(fd, req, started, frames, render_ms);
+    // counted before the reply so a client that then asks for stats sees it
+    stats.finish(!error, ms_since(accepted));
+    if (error && !started) {
+      reply(fd, std::string("error ") + error);
+    }
+    else if (!error && req.output != "-") {
+      char line[128];
+      snprintf(line, sizeof(line), "ok %llu %.2f %.2f", (unsigned long long)frames, wait_ms, render_ms);
+      reply(fd, line);
+    }
+    // a streamed job that fails part way has already sent "ok" so the
+    // client only sees the wave end early
+    close(fd);
+    printf("%-40s %10llu %10.2f %10.2f %s\n", req.song.c_str(), (unsigned long long)frames,
+      wait_ms, render_ms, error ? error : "ok");
+    fflush(stdout);
+  }
+
+  // answer a stats request
+  std::string describe() {
+    std::lock_guard<std::mutex> guard{ stats.mutex };
+    char line[256];
+    snprintf(line, sizeof(line),
+      "queue %u %u jobs %llu %llu %llu latency %.2f %.2f samples %zu %zu",
+      stats.waiting, stats.running, (unsigned long long)stats.done,
+      (unsigned long long)stats.failed, (unsigned long long)stats.rejected,
+      stats.done ? stats.total_ms / double(stats.done) : 0.0, stats.max_ms,
+      pool.size(), pool.bytes());
+    return line;
+  }
+
+  const options_t &opt;
+  sample_pool_t pool;
+  bank_t bank;
+  bool has_bank;
+  stats_t stats;
+};
+
+void usage() {
+  fprintf(stderr,
+    "usage: render_daemon -socket <path> [-bank <bank.txt>] [-j <threads>]\n"
+    "                     [-queue <jobs>] [-cache <mb>]\n");
+}
+
+bool parse_args(int argc, char **args, options_t &opt) {
+  for (int i = 1; i < argc; ++i) {
+    const char *a = args[i];
+    const bool has_value = (i + 1) < argc;
+    if (strcmp(a, "-socket") == 0 && has_value) {
+      opt.socket = args[++i];
+    }
+    else if (strcmp(a, "-bank") == 0 && has_value) {
+      opt.bank = args[++i];
+    }
+    else if (strcmp(a, "-j") == 0 && has_value) {
+      if (!parse_uint(args[++i], 1, ARG_MAX_THREADS, opt.threads)) {
+        return false;
+      }
+    }
+    else if (strcmp(a, "-queue") == 0 && has_value) {
+      if (!parse_uint(args[++i], 1, MAX_QUEUE, opt.queue)) {
+        return false;
+      }
+    }
+    else if (strcmp(a, "-cache") == 0 && has_value) {
+      if (!parse_uint(args[++i], 0, MAX_CACHE_MB, opt.cache_mb)) {
+        return false;
+      }
+    }
+    else {
+      return false;
+    }
+  }
+  return !opt.socket.empty();
+}
+
+}  // namespace
+
+int main(int argc, char **args) {
+  options_t opt;
+  if (!parse_args(argc, args, opt)) {
+    usage();
+    return 1;
+  }
+
+  server_t server{ opt };
+  if (!opt.bank.empty()) {
+    // bank samples go through the pool so songs using the same files
+    // share them
+    if (!server.bank.load(opt.bank.c_str(), &server.pool)) {
+      fprintf(stderr, "unable to load bank '%s'\n", opt.bank.c_str());
+      return 1;
+    }
+    server.has_bank = true;
+  }
+
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (opt.socket.size() >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "socket path too long\n");
+    return 1;
+  }
+  strcpy(addr.sun_path, opt.socket.c_str());
+  const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    fprintf(stderr, "unable to create socket\n");
+    return 1;
+  }
+  // a socket left behind by an earlier run would make bind fail
+  unlink(opt.socket.c_str());
+  if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 64) != 0) {
+    fprintf(stderr, "unable to listen on '%s'\n", opt.socket.c_str());
+    close(listener);
+    return 1;
+  }
+
+  // a client hanging up mid stream must not end the daemon, and a signal
+  // to quit has to interrupt poll()
+  signal(SIGPIPE, SIG_IGN);
+  struct sigaction quit;
+  memset(&quit, 0, sizeof(quit));
+  quit.sa_handler = on_signal;
+  sigaction(SIGINT, &quit, nullptr);
+  sigaction(SIGTERM, &quit, nullptr);
+
+  printf("listening on %s with %u threads\n", opt.socket.c_str(), opt.threads);
+  fflush(stdout);
+  {
+    thread_pool_t workers{ opt.threads };
+    // a request is only queued once its line has arrived, so a client that
+    // connects and sends nothing never holds up anyone else
+    std::vector<pending_t> pending;
+    std::vector<pollfd> fds;
+    server_t *s = &server;
+    const auto handle = [s, &opt, &workers](const pending_t &p) {
+      request_t req;
+      if (p.line == "stats") {
+        reply(p.fd, s->describe());
+        close(p.fd);
+        return;
+      }
+      if (!parse_request(p.line, req)) {
+        reply(p.fd, "error bad request");
+        close(p.fd);
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> guard{ s->stats.mutex };
+        if (s->stats.waiting >= opt.queue) {
+          ++s->stats.rejected;
+          reply(p.fd, "error busy");
+          close(p.fd);
+          return;
+        }
+        ++s->stats.waiting;
+      }
+      const int fd = p.fd;
+      const auto accepted = p.accepted;
+      workers.push([s, fd, req, accepted]() { s->run(fd, req, accepted); });
+    };
+    while (!_quit) {
+      fds.clear();
+      fds.push_back(pollfd{ listener, POLLIN, 0 });
+      for (const auto &p : pending) {
+        fds.push_back(pollfd{ p.fd, POLLIN, 0 });
+      }
+      if (poll(fds.data(), nfds_t(fds.size()), POLL_INTERVAL) < 0) {
+        continue;
+      }
+      // requests that are complete, broken or too slow leave the list
+      size_t kept = 0;
+      for (size_t i = 0; i < pending.size(); ++i) {
+        pending_t &p = pending[i];
+        read_t r = READ_MORE;
+        if (fds[i + 1].revents) {
+          r = read_pending(p);
+        }
+        if (r == READ_LINE) {
+          handle(p);
+        }
+        else if (r == READ_FAILED || ms_since(p.accepted) > REQUEST_TIMEOUT * 1000.0) {
+          close(p.fd);
+        }
+        else {
+          if (kept != i) {
+            pending[kept] = std::move(p);
+          }
+          ++kept;
+        }
+      }
+      pending.resize(kept);
+      if (fds[0].revents & POLLIN) {
+        const int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+          continue;
+        }
+        if (pending.size() >= MAX_PENDING) {
+          reply(fd, "error busy");
+          close(fd);
+          continue;
+        }
+        pending.push_back(pending_t{ fd, clock_type::now(), std::string() });
+      }
+    }
+    for (const auto &p : pending) {
+      close(p.fd);
+    }
+    // finish the jobs already accepted
+    workers.wait();
+  }
+  close(listener);
+  unlink(opt.socket.c_str());
+  return 0;
+}
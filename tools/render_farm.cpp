@@ -0,0 +1,264 @@
+// batch render standard midi files to wav using an instrument bank
+//
+//   render_farm -bank <bank.txt> [-j <threads>] [-rate <hz>]
+//               [-engine-rate <hz>] [-format s16|s24|f32] [-o <dir>]
+//               [-trace <trace.json>] <file.mid> ...
+//
+// each file is rendered by its own engine_t on a thread pool, and
+// per job timing plus the aggregate throughput are reported when all jobs
+// have finished. with -engine-rate the songs are played at that rate and
+// resampled to the output rate. audio is streamed to disk as it is rendered,
+// files over 4gb are written as rf64. -trace saves the trace zones of the
+// run when built with TRACKER_TRACE.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "libwav.h"
+#include "bank.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "args.h"
+
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+double ms_since(clock_type::time_point t) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - t).count();
+}
+
+struct options_t {
+
+  options_t()
+    : threads(std::max(std::thread::hardware_concurrency(), 1u))
+    , rate(44100)
+    , engine_rate(0)
+    , type(WAVE_PCM16)
+    , max_seconds(60 * 60)
+  {
+  }
+
+  std::string bank;
+  std::string out_dir;
+  std::string trace;
+  uint32_t threads;
+  uint32_t rate;
+  // rate the player runs at, 0 to match the output rate
+  uint32_t engine_rate;
+  wave_sample_t type;
+  // longest render allowed for a single file
+  uint32_t max_seconds;
+  std::vector<std::string> inputs;
+};
+
+struct job_t {
+
+  job_t()
+    : ok(false)
+    , error("")
+    , frames(0)
+    , parse_ms(0.0)
+    , render_ms(0.0)
+    , write_ms(0.0)
+  {
+  }
+
+  std::string input;
+  std::string output;
+  bool ok;
+  const char *error;
+  Tracker::smf_info_t info;
+  uint64_t frames;
+  double parse_ms;
+  double render_ms;
+  double write_ms;
+};
+
+// output path is the input file name with a .wav extension in out_dir
+std::string output_path(const options_t &opt, const std::string &input) {
+  size_t slash = input.find_last_of("/\\");
+  std::string name = (slash == std::string::npos) ? input : input.substr(slash + 1);
+  const size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos) {
+    name = name.substr(0, dot);
+  }
+  std::string dir = opt.out_dir;
+  if (!dir.empty() && dir.back() != '/' && dir.back() != '\\') {
+    dir += '/';
+  }
+  return dir + name + ".wav";
+}
+
+void run_job(const options_t &opt, const Tracker::bank_t &bank, job_t &job) {
+  TRACE_ZONE("run_job");
+  auto t = clock_type::now();
+
+  // every job owns its engine so nothing is shared between threads other
+  // than the immutable bank samples
+  Tracker::engine_t engine{ opt.rate, opt.engine_rate ? opt.engine_rate : opt.rate };
+  if (opt.engine_rate && engine.engine_rate() != opt.engine_rate) {
+    job.error = "unsupported engine rate";
+    return;
+  }
+  if (!engine.load_midi(job.input.c_str(), bank, job.info)) {
+    job.error = job.info.too_long ? "midi file too long for a song" : "unable to parse midi file";
+    return;
+  }
+  job.parse_ms = ms_since(t);
+
+  // blocks are written as they are rendered so memory use does not grow
+  // with the length of the song
+  wave_writer_t wave;
+  if (!wave.open(job.output.c_str(), 1, opt.rate, opt.type)) {
+    job.error = "unable to create wave";
+    return;
+  }
+  engine.play();
+  const uint64_t max_frames = uint64_t(opt.rate) * opt.max_seconds;
+  std::array<int16_t, 4096> temp;
+  while (wave.frames() < max_frames) {
+    t = clock_type::now();
+    const uint32_t done = engine.render(temp.data(), uint32_t(temp.size()));
+    job.render_ms += ms_since(t);
+    if (!done) {
+      break;
+    }
+    t = clock_type::now();
+    const bool ok = wave.write(temp.data(), done);
+    job.write_ms += ms_since(t);
+    if (!ok) {
+      job.error = "unable to write wave";
+      return;
+    }
+  }
+  job.frames = wave.frames();
+  t = clock_type::now();
+  if (!wave.close()) {
+    job.error = "unable to write wave";
+    return;
+  }
+  job.write_ms += ms_since(t);
+  job.ok = true;
+}
+
+void usage() {
+  fprintf(stderr,
+    "usage: render_farm -bank <bank.txt> [-j <threads>] [-rate <hz>]\n"
+    "                   [-engine-rate <hz>] [-format s16|s24|f32] [-o <dir>]\n"
+    "                   [-trace <trace.json>] <file.mid> ...\n");
+}
+
+bool parse_args(int argc, char **args, options_t &opt) {
+  for (int i = 1; i < argc; ++i) {
+    const char *a = args[i];
+    const bool has_value = (i + 1) < argc;
+    if (strcmp(a, "-bank") == 0 && has_value) {
+      opt.bank = args[++i];
+    }
+    else if (strcmp(a, "-j") == 0 && has_value) {
+      if (!parse_uint(args[++i], 1, ARG_MAX_THREADS, opt.threads)) {
+        return false;
+      }
+    }
+    else if (strcmp(a, "-rate") == 0 && has_value) {
+      if (!parse_uint(args[++i], ARG_MIN_RATE, ARG_MAX_RATE, opt.rate)) {
+        return false;
+      }
+    }
+    else if (strcmp(a, "-engine-rate") == 0 && has_value) {
+      if (!parse_uint(args[++i], ARG_MIN_RATE, ARG_MAX_RATE, opt.engine_rate)) {
+        return false;
+      }
+    }
+    else if (strcmp(a, "-format") == 0 && has_value) {
+      if (!wave_sample_parse(args[++i], opt.type)) {
+        return false;
+      }
+    }
+    else if (strcmp(a, "-o") == 0 && has_value) {
+      opt.out_dir = args[++i];
+    }
+    else if (strcmp(a, "-trace") == 0 && has_value) {
+      opt.trace = args[++i];
+    }
+    else if (a[0] == '-') {
+      return false;
+    }
+    else {
+      opt.inputs.push_back(a);
+    }
+  }
+  return !opt.bank.empty() && !opt.inputs.empty();
+}
+
+}  // namespace
+
+int main(int argc, char **args) {
+  TRACE_THREAD("main");
+  options_t opt;
+  if (!parse_args(argc, args, opt)) {
+    usage();
+    return 1;
+  }
+
+  Tracker::bank_t bank;
+  if (!bank.load(opt.bank.c_str())) {
+    fprintf(stderr, "unable to load bank '%s'\n", opt.bank.c_str());
+    return 1;
+  }
+
+  std::vector<job_t> jobs(opt.inputs.size());
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    jobs[i].input = opt.inputs[i];
+    jobs[i].output = output_path(opt, opt.inputs[i]);
+  }
+
+  const auto start = clock_type::now();
+  {
+    thread_pool_t pool{ opt.threads };
+    for (auto &job : jobs) {
+      job_t *j = &job;
+      pool.push([&opt, &bank, j]() { run_job(opt, bank, *j); });
+    }
+    pool.wait();
+  }
+  const double wall_ms = ms_since(start);
+  if (!opt.trace.empty() && !Tracker::trace_save(opt.trace.c_str())) {
+    fprintf(stderr, "unable to save trace '%s'%s\n", opt.trace.c_str(),
+      Tracker::trace_enabled() ? "" : ", built without TRACKER_TRACE");
+  }
+
+  double audio_seconds = 0.0;
+  double busy_ms = 0.0;
+  uint32_t failed = 0;
+  printf("%-40s %10s %10s %10s %10s %8s %8s\n",
+    "file", "audio(s)", "parse(ms)", "render(ms)", "write(ms)", "notes", "dropped");
+  for (const auto &job : jobs) {
+    if (!job.ok) {
+      printf("%-40s failed: %s\n", job.input.c_str(), job.error);
+      ++failed;
+      continue;
+    }
+    const double seconds = double(job.frames) / double(opt.rate);
+    printf("%-40s %10.2f %10.2f %10.2f %10.2f %8u %8u\n",
+      job.input.c_str(), seconds, job.parse_ms, job.render_ms, job.write_ms,
+      job.info.notes, job.info.dropped);
+    audio_seconds += seconds;
+    busy_ms += job.parse_ms + job.render_ms + job.write_ms;
+  }
+  printf("\n%u jobs, %u failed, %u threads\n", uint32_t(jobs.size()), failed, opt.threads);
+  printf("audio %.2fs in %.2fs wall (%.2fs busy)\n",
+    audio_seconds, wall_ms / 1000.0, busy_ms / 1000.0);
+  printf("throughput %.2f audio-seconds per wall-second\n",
+    (wall_ms > 0.0) ? audio_seconds / (wall_ms / 1000.0) : 0.0);
+  return failed ? 1 : 0;
+}
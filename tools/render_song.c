@@ -0,0 +1,100 @@
+/* render a song file to a 16 bit mono wav through the c interface
+ *
+ *   render_song [-rate <hz>] <song.txt> <out.wav>
+ *
+ * this doubles as an example of embedding the engine in a c program. */
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracker_c.h"
+
+
+enum {
+  BLOCK_FRAMES = 4096,
+  /* longest song rendered */
+  MAX_SECONDS = 60 * 60,
+};
+
+static void put_u16(FILE *fd, uint32_t v) {
+  fputc(v & 0xff, fd);
+  fputc((v >> 8) & 0xff, fd);
+}
+
+static void put_u32(FILE *fd, uint32_t v) {
+  put_u16(fd, v & 0xffff);
+  put_u16(fd, v >> 16);
+}
+
+/* write a canonical 44 byte wave header for 16 bit mono data */
+static void put_header(FILE *fd, uint32_t rate, uint32_t frames) {
+  const uint32_t bytes = frames * 2;
+  fwrite("RIFF", 1, 4, fd);
+  put_u32(fd, 36 + bytes);
+  fwrite("WAVEfmt ", 1, 8, fd);
+  put_u32(fd, 16);
+  put_u16(fd, 1);
+  put_u16(fd, 1);
+  put_u32(fd, rate);
+  put_u32(fd, rate * 2);
+  put_u16(fd, 2);
+  put_u16(fd, 16);
+  fwrite("data", 1, 4, fd);
+  put_u32(fd, bytes);
+}
+
+int main(int argc, char **args) {
+  uint32_t rate = 44100;
+  int i = 1;
+  if (argc > 2 && strcmp(args[1], "-rate") == 0) {
+    rate = (uint32_t)atoi(args[2]);
+    i = 3;
+  }
+  if (argc - i != 2 || rate == 0) {
+    fprintf(stderr, "usage: render_song [-rate <hz>] <song.txt> <out.wav>\n");
+    return 1;
+  }
+
+  tracker_engine_t *engine = tracker_engine_create(rate);
+  if (!engine) {
+    fprintf(stderr, "unable to create engine\n");
+    return 1;
+  }
+  if (!tracker_engine_load_song(engine, args[i])) {
+    fprintf(stderr, "unable to load song '%s'\n", args[i]);
+    tracker_engine_destroy(engine);
+    return 1;
+  }
+  FILE *fd = fopen(args[i + 1], "wb");
+  if (!fd) {
+    fprintf(stderr, "unable to open '%s'\n", args[i + 1]);
+    tracker_engine_destroy(engine);
+    return 1;
+  }
+
+  /* the header is rewritten once the length is known */
+  put_header(fd, rate, 0);
+  uint32_t frames = 0;
+  int16_t block[BLOCK_FRAMES];
+  while (frames < rate * MAX_SECONDS) {
+    const uint32_t done = tracker_engine_render(engine, block, BLOCK_FRAMES);
+    if (done == 0) {
+      break;
+    }
+    /* wave data is little endian */
+    for (uint32_t j = 0; j < done; ++j) {
+      put_u16(fd, (uint16_t)block[j]);
+    }
+    frames += done;
+  }
+  fseek(fd, 0, SEEK_SET);
+  put_header(fd, rate, frames);
+  const int ok = !ferror(fd);
+  fclose(fd);
+  tracker_engine_destroy(engine);
+
+  printf("%s: %.2fs\n", args[i + 1], (double)frames / rate);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+// analyse a library of wave files for pitch, loop points and levels
+//
+//   sample_analyse [-j <threads>] [-f] <file.wav> ...
+//
+// files are analysed in parallel on a thread pool and the results written
+// to a cache next to each file, which the tracker reads when the sample is
+// assigned to an instrument. files with an up to date cache are skipped
+// unless -f is given.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "bank.h"
+#include "thread_pool.h"
+#include "args.h"
+
+
+namespace {
+
+using namespace Tracker;
+
+typedef std::chrono::steady_clock clock_type;
+
+struct job_t {
+
+  job_t()
+    : ok(false)
+    , cached(false)
+    , ms(0.0)
+  {
+  }
+
+  std::string path;
+  bool ok;
+  // true if the results came from the cache
+  bool cached;
+  double ms;
+  sample_analysis_t result;
+};
+
+void run_job(bool force, job_t &job) {
+  const auto t = clock_type::now();
+  wave_info_t info;
+  if (!wave_t::load_info(job.path.c_str(), info)) {
+    return;
+  }
+  if (!force && analysis_load(job.path, info, job.result)) {
+    job.ok = job.cached = true;
+    return;
+  }
+  auto sample = sample_load(job.path.c_str());
+  if (!sample) {
+    return;
+  }
+  sample_analyse(*sample, job.result);
+  job.ok = analysis_save(job.path, info, job.result);
+  job.ms = std::chrono::duration<double, std::milli>(clock_type::now() - t).count();
+}
+
+}  // namespace
+
+int main(int argc, char **args) {
+  uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+  bool force = false;
+  bool bad = false;
+  std::vector<job_t> jobs;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(args[i], "-j") == 0 && (i + 1) < argc) {
+      bad |= !parse_uint(args[++i], 1, ARG_MAX_THREADS, threads);
+    }
+    else if (strcmp(args[i], "-f") == 0) {
+      force = true;
+    }
+    else {
+      jobs.emplace_back();
+      jobs.back().path = args[i];
+    }
+  }
+  if (jobs.empty() || bad) {
+    fprintf(stderr, "usage: sample_analyse [-j <threads>] [-f] <file.wav> ...\n");
+    return 1;
+  }
+
+  {
+    thread_pool_t pool{ threads };
+    for (auto &job : jobs) {
+      job_t *j = &job;
+      pool.push([force, j]() { run_job(force, *j); });
+    }
+    pool.wait();
+  }
+
+  uint32_t failed = 0;
+  printf("%-40s %5s %8s %10s %10s %10s %10s %8s %8s %8s\n", "file", "root", "fine",
+    "start", "end", "loop", "loop end", "peak(db)", "rms(db)", "ms");
+  for (const auto &job : jobs) {
+    if (!job.ok) {
+      printf("%-40s failed\n", job.path.c_str());
+      ++failed;
+      continue;
+    }
+    const sample_analysis_t &r = job.result;
+    char root[8] = "-", fine[16] = "-", loop[16] = "-", loop_end[16] = "-", ms[16] = "cached";
+    if (r.pitched) {
+      snprintf(root, sizeof(root), "%u", r.root);
+      snprintf(fine, sizeof(fine), "%+.3f", r.fine);
+    }
+    if (r.loopable) {
+      snprintf(loop, sizeof(loop), "%u", r.loop_start);
+      snprintf(loop_end, sizeof(loop_end), "%u", r.loop_end);
+    }
+    if (!job.cached) {
+      snprintf(ms, sizeof(ms), "%.2f", job.ms);
+    }
+    printf("%-40s %5s %8s %10u %10u %10s %10s %8.1f %8.1f %8s\n", job.path.c_str(), root,
+      fine, r.start, r.end, loop, loop_end, r.peak_db, r.rms_db, ms);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,295 @@
+// render a song to one wave per instrument plus the full mix in one pass
+//
+//   stem_export [-bank <bank.txt>] [-j <threads>] [-rate <hz>]
+//               [-format s16|s24|f32] [-o <dir>] <song.txt|file.mid>
+//
+// the player routes each voice to the stem of its instrument, so the song is
+// played once however many instruments it uses and the stems add up exactly
+// to the mix. stems are written as <name>_ins<nn>.wav for every instrument
+// the song order list plays, and the mix as <name>.wav. while one block is
+// rendered the block before it is mixed down and written out on a thread
+// pool, one job per file. midi files need a -bank.
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "libwav.h"
+#include "bank.h"
+#include "thread_pool.h"
+#include "args.h"
+
+
+namespace {
+
+using namespace Tracker;
+
+typedef std::chrono::steady_clock clock_type;
+
+double ms_since(clock_type::time_point t) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - t).count();
+}
+
+enum {
+  // frames rendered before each hand over to the writers, the same blocks
+  // as render_farm so the mix is identical to its output
+  BLOCK = 4096,
+};
+
+struct options_t {
+
+  options_t()
+    : threads(std::max(std::thread::hardware_concurrency(), 1u))
+    , rate(44100)
+    , type(WAVE_PCM16)
+    , max_seconds(60 * 60)
+  {
+  }
+
+  std::string bank;
+  std::string out_dir;
+  uint32_t threads;
+  uint32_t rate;
+  wave_sample_t type;
+  // longest render allowed
+  uint32_t max_seconds;
+  std::string input;
+};
+
+// one block of audio for every stem and the mix
+struct block_t {
+
+  block_t()
+    : frames(0)
+  {
+    for (auto &s : stems) {
+      s.resize(BLOCK);
+    }
+    mix.resize(BLOCK);
+  }
+
+  std::array<std::vector<int16_t>, MAX_INSTUMENTS> stems;
+  std::vector<int16_t> mix;
+  uint32_t frames;
+};
+
+// input file name without its directory or extension
+std::string base_name(const std::string &input) {
+  size_t slash = input.find_last_of("/\\");
+  std::string name = (slash == std::string::npos) ? input : input.substr(slash + 1);
+  const size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos) {
+    name = name.substr(0, dot);
+  }
+  return name;
+}
+
+// instruments with a sample that are played by the song order list
+uint32_t used_instruments(const song_t &song) {
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < song.orders_head; ++i) {
+    const pattern_t &pat = song.patterns[song.orders[i]];
+    for (uint32_t j = 0; j < pat.notes_head; ++j) {
+      const uint32_t ins = pat.notes[j].instrument;
+      if (song.instruments[ins].sample()) {
+        used |= 1u << ins;
+      }
+    }
+  }
+  return used;
+}
+
+// add the stems of every used instrument into the mix
+void mix_down(block_t &block, uint32_t used) {
+  std::fill(block.mix.begin(), block.mix.begin() + block.frames, int16_t(0));
+  for (uint32_t i = 0; i < MAX_INSTUMENTS; ++i) {
+    if (!(used & (1u << i))) {
+      continue;
+    }
+    const int16_t *in = block.stems[i].data();
+    int16_t *out = block.mix.data();
+    for (uint32_t j = 0; j < block.frames; ++j) {
+      // wraps as the player's own mixing does
+      out[j] = int16_t(out[j] + in[j]);
+    }
+  }
+}
+
+void usage() {
+  fprintf(stderr,
+    "usage: stem_export [-bank <bank.txt>] [-j <threads>] [-rate <hz>]\n"
+    "                   [-format s16|s24|f32] [-o <dir>] <song.txt|file.mid>\n");
+}
+
+bool parse_args(int argc, char **args, options_t &opt) {
+  for (int i = 1; i < argc; ++i) {
+    const char *a = args[i];
+    const bool has_value = (i + 1) < argc;
+    if (strcmp(a, "-bank") == 0 && has_value) {
+      opt.bank = args[++i];
+    }
+    else if (strcmp(a, "-j") == 0 && has_value) {
+      if (!parse_uint(args[++i], 1, ARG_MAX_THREADS, opt.threads)) {
+        return false;
+      }
+    }
+    else if (strcmp(a, "-rate") == 0 && has_value) {
+      if (!parse_uint(args[++i], ARG_MIN_RATE, ARG_MAX_RATE, opt.rate)) {
+        return false;
+      }
+    }
+    else if (strcmp(a, "-format") == 0 && has_value) {
+      if (!wave_sample_parse(args[++i], opt.type)) {
+        return false;
+      }
+    }
+    else if (strcmp(a, "-o") == 0 && has_value) {
+      opt.out_dir = args[++i];
+    }
+    else if (a[0] == '-' || !opt.input.empty()) {
+      return false;
+    }
+    else {
+      opt.input = a;
+    }
+  }
+  return !opt.input.empty();
+}
+
+}  // namespace
+
+int main(int argc, char **args) {
+  options_t opt;
+  if (!parse_args(argc, args, opt)) {
+    usage();
+    return 1;
+  }
+
+  engine_t engine{ opt.rate };
+  bank_t bank;
+  if (is_midi(opt.input.c_str())) {
+    if (opt.bank.empty()) {
+      fprintf(stderr, "a -bank is needed to import '%s'\n", opt.input.c_str());
+      return 1;
+    }
+    if (!bank.load(opt.bank.c_str())) {
+      fprintf(stderr, "unable to load bank '%s'\n", opt.bank.c_str());
+      return 1;
+    }
+    smf_info_t info;
+    if (!engine.load_midi(opt.input.c_str(), bank, info)) {
+      fprintf(stderr, "unable to parse midi file '%s'\n", opt.input.c_str());
+      return 1;
+    }
+  }
+  else if (!engine.load_song(opt.input.c_str())) {
+    fprintf(stderr, "unable to load song '%s'\n", opt.input.c_str());
+    return 1;
+  }
+
+  const uint32_t used = used_instruments(engine.song());
+  std::string prefix = opt.out_dir;
+  if (!prefix.empty() && prefix.back() != '/' && prefix.back() != '\\') {
+    prefix += '/';
+  }
+  prefix += base_name(opt.input);
+
+  // the mix then a writer for each used instrument
+  std::vector<std::string> paths;
+  std::vector<wave_writer_t> writers(MAX_INSTUMENTS + 1);
+  paths.push_back(prefix + ".wav");
+  for (uint32_t i = 0; i < MAX_INSTUMENTS; ++i) {
+    char name[16];
+    snprintf(name, sizeof(name), "_ins%02u.wav", i);
+    paths.push_back((used & (1u << i)) ? prefix + name : std::string());
+  }
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!paths[i].empty() && !writers[i].open(paths[i].c_str(), 1, opt.rate, opt.type)) {
+      fprintf(stderr, "unable to create '%s'\n", paths[i].c_str());
+      return 1;
+    }
+  }
+
+  const auto start = clock_type::now();
+  double render_ms = 0.0;
+  std::atomic<bool> failed{ false };
+  {
+    thread_pool_t pool{ opt.threads };
+    std::array<block_t, 2> blocks;
+    uint32_t current = 0;
+    uint64_t frames = 0;
+    const uint64_t max_frames = uint64_t(opt.rate) * opt.max_seconds;
+    player_t &player = engine.player();
+    engine.play();
+    while (player.playing() && frames < max_frames && !failed) {
+      // render into one block while the other is still being written
+      block_t &block = blocks[current];
+      std::array<int16_t *, MAX_INSTUMENTS> stems;
+      for (uint32_t i = 0; i < MAX_INSTUMENTS; ++i) {
+        std::fill(block.stems[i].begin(), block.stems[i].end(), int16_t(0));
+        stems[i] = block.stems[i].data();
+      }
+      const auto t = clock_type::now();
+      player.render_stems(stems.data(), BLOCK);
+      render_ms += ms_since(t);
+      block.frames = BLOCK;
+      frames += BLOCK;
+
+      pool.wait();
+      block_t *b = &block;
+      wave_writer_t *mix = &writers[0];
+      pool.push([b, mix, used, &failed]() {
+        mix_down(*b, used);
+        if (!mix->write(b->mix.data(), b->frames)) {
+          failed = true;
+        }
+      });
+      for (uint32_t i = 0; i < MAX_INSTUMENTS; ++i) {
+        if (!(used & (1u << i))) {
+          continue;
+        }
+        wave_writer_t *w = &writers[i + 1];
+        pool.push([b, w, i, &failed]() {
+          if (!w->write(b->stems[i].data(), b->frames)) {
+            failed = true;
+          }
+        });
+      }
+      current ^= 1;
+    }
+    pool.wait();
+  }
+
+  uint64_t written = 0;
+  uint32_t count = 0;
+  for (size_t i = 0; i < writers.size(); ++i) {
+    if (!writers[i].is_open()) {
+      continue;
+    }
+    written = writers[i].frames();
+    count += (i > 0) ? 1 : 0;
+    if (!writers[i].close()) {
+      failed = true;
+    }
+  }
+  if (failed) {
+    fprintf(stderr, "unable to write stems\n");
+    return 1;
+  }
+  for (const auto &path : paths) {
+    if (!path.empty()) {
+      printf("%s\n", path.c_str());
+    }
+  }
+  const double wall_ms = ms_since(start);
+  printf("\n%u stems, audio %.2fs, render %.2fms, wall %.2fms, %u threads\n",
+    count, double(written) / double(opt.rate), render_ms, wall_ms, opt.threads);
+  return 0;
+}